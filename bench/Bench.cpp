@@ -0,0 +1,137 @@
+#include "Bench.h"
+
+#include "JsonWriter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+
+std::atomic<std::uint64_t> g_allocations{0};
+
+using Clock = std::chrono::steady_clock;
+
+std::string g_filter;
+double g_min_time_ns = 200e6;
+
+// Time and allocations of the current run, minus paused stretches.
+Clock::time_point g_started;
+std::int64_t g_paused_ns = 0;
+std::uint64_t g_paused_allocs = 0;
+Clock::time_point g_pause_at;
+std::uint64_t g_pause_allocs_at = 0;
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t a = static_cast<std::size_t>(align);
+    if (void* p = std::aligned_alloc(a, (std::max<std::size_t>(size, 1) + a - 1) / a * a)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t align) {
+    return ::operator new(size, align);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace bench {
+
+void configure(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(argv[i], "--filter") == 0 && val) {
+            g_filter = val;
+            ++i;
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && val) {
+            g_min_time_ns = std::atof(val) * 1e6;
+            ++i;
+        } else {
+            std::fprintf(stderr, "usage: %s [--filter SUBSTR] [--min-time MS]\n", argv[0]);
+            std::exit(2);
+        }
+    }
+}
+
+bool selected(const std::string& name) {
+    return g_filter.empty() || name.find(g_filter) != std::string::npos;
+}
+
+std::uint64_t allocations() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+void pause() {
+    g_pause_at = Clock::now();
+    g_pause_allocs_at = allocations();
+}
+
+void resume() {
+    g_paused_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - g_pause_at).count();
+    g_paused_allocs += allocations() - g_pause_allocs_at;
+}
+
+void run(const std::string& name, const Body& body, std::size_t bytes_per_op) {
+    if (!selected(name)) return;
+
+    std::size_t iterations = 1;
+    double ns = 0;
+    std::uint64_t allocs = 0;
+    for (;;) {
+        g_paused_ns = 0;
+        g_paused_allocs = 0;
+        std::uint64_t allocs_before = allocations();
+        g_started = Clock::now();
+        body(iterations);
+        ns = static_cast<double>(
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - g_started).count() -
+                 g_paused_ns);
+        allocs = allocations() - allocs_before - g_paused_allocs;
+        if (ns >= g_min_time_ns || iterations >= (std::size_t{1} << 32)) break;
+        // aim 20% past the minimum, growing at least 2x and at most 100x
+        double scale = ns > 0 ? g_min_time_ns * 1.2 / ns : 100.0;
+        iterations = static_cast<std::size_t>(iterations * std::clamp(scale, 2.0, 100.0));
+    }
+
+    const double per_op = ns / static_cast<double>(iterations);
+    std::string line = "{\"name\":";
+    JsonWriter::appendString(line, name);
+    char buf[192];
+    int n = std::snprintf(buf, sizeof(buf),
+                          ",\"iterations\":%zu,\"ns_per_op\":%.1f,\"allocs_per_op\":%.3f,\"ops_per_sec\":%.0f",
+                          iterations, per_op, static_cast<double>(allocs) / static_cast<double>(iterations),
+                          1e9 / per_op);
+    line.append(buf, static_cast<std::size_t>(n));
+    if (bytes_per_op > 0) {
+        n = std::snprintf(buf, sizeof(buf), ",\"mb_per_sec\":%.1f", bytes_per_op * 1e3 / per_op);
+        line.append(buf, static_cast<std::size_t>(n));
+    }
+    line += "}\n";
+    std::fwrite(line.data(), 1, line.size(), stdout);
+    std::fflush(stdout);
+}
+
+} // namespace bench
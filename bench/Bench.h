@@ -0,0 +1,44 @@
+// Bench.h
+// Minimal harness behind `make bench`. A case body performs a given number
+// of operations; the harness grows that number until one run takes at
+// least the minimum time, then prints one JSON object per line:
+//
+//   {"name":"...","iterations":N,"ns_per_op":X,"allocs_per_op":Y,"ops_per_sec":Z}
+//
+// plus "mb_per_sec" when the case declares bytes per operation. Heap
+// allocations are counted by replacing the global operator new, so they
+// include every thread of the process (worker pool, reactor).
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace bench {
+
+// Runs `iterations` operations.
+using Body = std::function<void(std::size_t iterations)>;
+
+// Command line: --filter SUBSTR (run matching cases only), --min-time MS.
+void configure(int argc, char** argv);
+
+bool selected(const std::string& name);
+
+void run(const std::string& name, const Body& body, std::size_t bytes_per_op = 0);
+
+// Exclude per-iteration setup inside a body from time and allocation counts.
+void pause();
+void resume();
+
+// Heap allocations so far, all threads.
+std::uint64_t allocations();
+
+// Keep a computed value alive without emitting code for it.
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // namespace bench
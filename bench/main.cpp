@@ -0,0 +1,289 @@
+// Microbenchmarks for the hot paths: book generation, market data
+// serialization, inbound parsing, queues and the reactor fan-out.
+// Run with `make bench` (BENCH_ARGS="--filter queue" to pick cases).
+
+#include "Bench.h"
+
+#include "BinaryProtocol.h"
+#include "Client.h"
+#include "JsonWriter.h"
+#include "LockFreeQueue.h"
+#include "MarketDataGenerator.h"
+#include "OrderBook.h"
+#include "Reactor.h"
+#include "ReadBuffer.h"
+#include "ThreadSafeQueue.h"
+#include "WorkerPool.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void benchOrderBook() {
+    OrderBook book(100, 50, 1);
+    std::vector<ExecutionReport> reports;
+    bench::run("orderbook/rebuildAround", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            book.rebuildAround(reports);
+            reports.clear();
+        }
+    });
+
+    std::string out;
+    bench::run("orderbook/writeTop5OfBook", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out.clear();
+            JsonWriter w(out);
+            book.writeTop5OfBook(w);
+            bench::doNotOptimize(out.data());
+        }
+    });
+}
+
+// A tick of a fresh generator: every book is due, so this is the full
+// rebuild + publish + snapshot serialization of the universe.
+void benchMarketData() {
+    for (std::size_t symbols : {1, 100, 1000, 10000}) {
+        for (bool binary : {false, true}) {
+            std::string name = "marketdata/full_tick" + std::string(binary ? "_binary/" : "/") +
+                               std::to_string(symbols);
+            bench::run(name, [&](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    bench::pause();
+                    auto mdg = std::make_unique<MarketDataGenerator>(symbols);
+                    bench::resume();
+                    bench::doNotOptimize(mdg->makeMarketData());
+                    if (binary) bench::doNotOptimize(mdg->makeMarketDataBinary());
+                    bench::pause();
+                    mdg.reset();
+                    bench::resume();
+                }
+            });
+        }
+    }
+}
+
+// Inbound path of one connection: frames arrive in the read buffer, the
+// reactor parses them and queues the messages for the worker pool.
+class ParseFixture {
+public:
+    ParseFixture() : pool_(1) {
+        socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds_);
+        client_ = std::make_unique<Client>(fds_[0], pool_, buffers_);
+    }
+
+    ~ParseFixture() {
+        drain();
+        client_.reset();
+        close(fds_[0]);
+        close(fds_[1]);
+    }
+
+    void feed(const char* data, std::size_t len) {
+        ReadBuffer& in = client_->readBuffer();
+        char* dst = in.prepare(len);
+        std::memcpy(dst, data, len);
+        in.commit(len);
+        while (client_->tryParseReadBuffer()) {
+        }
+    }
+
+    // Responses pile up in the outbound queue; send and discard them.
+    void drain() {
+        char sink[1 << 16];
+        while (client_->hasPendingWrite() && client_->flushWriteBufferNonBlocking() > 0) {
+            while (recv(fds_[1], sink, sizeof(sink), MSG_DONTWAIT) > 0) {
+            }
+        }
+        while (recv(fds_[1], sink, sizeof(sink), MSG_DONTWAIT) > 0) {
+        }
+    }
+
+private:
+    WorkerPool pool_;
+    BufferPool buffers_;
+    int fds_[2];
+    std::unique_ptr<Client> client_;
+};
+
+void benchParse() {
+    const std::string login = R"({"action":"login","username":"bench","password":"secret"})";
+    constexpr std::size_t kPipelined = 64;
+
+    std::string batch;
+    for (std::size_t i = 0; i < kPipelined; ++i) batch += login;
+    bench::run("client/parse_json_pipelined", [&](std::size_t n) {
+        ParseFixture f;
+        for (std::size_t i = 0; i < n; i += kPipelined) {
+            f.feed(batch.data(), batch.size());
+            bench::pause();
+            f.drain();
+            bench::resume();
+        }
+    }, login.size());
+
+    bench::run("client/parse_json_fragmented", [&](std::size_t n) {
+        ParseFixture f;
+        const std::size_t third = login.size() / 3;
+        for (std::size_t i = 0; i < n; ++i) {
+            f.feed(login.data(), third);
+            f.feed(login.data() + third, third);
+            f.feed(login.data() + 2 * third, login.size() - 2 * third);
+            if (i % kPipelined == kPipelined - 1) {
+                bench::pause();
+                f.drain();
+                bench::resume();
+            }
+        }
+    }, login.size());
+
+    std::string frame;
+    std::size_t at = wire::beginFrame(frame, static_cast<std::uint16_t>(MessageType::Login), 1);
+    wire::LoginRequest req{};
+    wire::copyFixed(req.username, sizeof(req.username), "bench");
+    wire::copyFixed(req.password, sizeof(req.password), "secret");
+    wire::appendPod(frame, req);
+    wire::endFrame(frame, at);
+    std::string binary_batch;
+    for (std::size_t i = 0; i < kPipelined; ++i) binary_batch += frame;
+    bench::run("client/parse_binary_pipelined", [&](std::size_t n) {
+        ParseFixture f;
+        for (std::size_t i = 0; i < n; i += kPipelined) {
+            f.feed(binary_batch.data(), binary_batch.size());
+            bench::pause();
+            f.drain();
+            bench::resume();
+        }
+    }, frame.size());
+}
+
+// One producer thread hands items to the benchmark thread; op = one item.
+template <typename Queue>
+void benchQueue(const std::string& name, Queue& queue) {
+    bench::run(name, [&](std::size_t n) {
+        std::thread producer([&] {
+            for (std::size_t i = 0; i < n; ++i) queue.push(i);
+        });
+        std::size_t v = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            while (!queue.try_pop(v)) std::this_thread::yield();
+        }
+        producer.join();
+        bench::doNotOptimize(v);
+    });
+}
+
+void benchQueues() {
+    ThreadSafeQueue<std::size_t> locked;
+    benchQueue("queue/ThreadSafeQueue", locked);
+    SpscQueue<std::size_t> spsc(4096);
+    benchQueue("queue/SpscQueue", spsc);
+    MpmcQueue<std::size_t> mpmc(4096);
+    benchQueue("queue/MpmcQueue", mpmc);
+}
+
+std::uint16_t freePort() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+    close(fd);
+    return ntohs(addr.sin_port);
+}
+
+// Reactor::broadcast to N connected clients; op = one tick to all of them.
+// Broadcasts are posted to the reactor thread in batches and timed until
+// the batch finishes; sending the queued frames happens afterwards in the
+// event loop and is not timed. Draining between batches keeps the queued
+// bytes bounded however many iterations the harness asks for.
+void benchBroadcast() {
+    constexpr std::size_t kFrameBytes = 1024;
+    constexpr std::size_t kBatch = 64;
+    for (std::size_t clients : {1, 10, 100}) {
+        std::string name = "reactor/broadcast/" + std::to_string(clients);
+        if (!bench::selected(name)) continue;
+
+        WorkerPool pool(1);
+        OutboundLimits unlimited{std::size_t{1} << 40, std::size_t{1} << 40, 0};
+        Reactor reactor(pool, nullptr, unlimited);
+        std::uint16_t port = freePort();
+        if (!reactor.init(port, false, nullptr)) {
+            std::fprintf(stderr, "%s: cannot listen on port %u, skipped\n", name.c_str(), port);
+            continue;
+        }
+        std::thread loop([&] { reactor.run(); });
+
+        std::vector<int> socks;
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        for (std::size_t i = 0; i < clients; ++i) {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+            socks.push_back(fd);
+        }
+        // let the reactor accept them, and wait out the protocol grace: until
+        // then broadcast() skips clients that never sent anything
+        std::this_thread::sleep_for(std::chrono::milliseconds(Reactor::kProtocolGraceMs + 100));
+
+        MarketDataFrame frame;
+        frame.json = std::make_shared<const std::string>(kFrameBytes, 'x');
+        std::vector<char> sink(1 << 16);
+        bench::run(name, [&](std::size_t n) {
+            for (std::size_t left = n; left > 0; ) {
+                const std::size_t batch = std::min(left, kBatch);
+                left -= batch;
+                // shared: the reactor still notifies after we may have returned
+                auto done = std::make_shared<std::atomic<bool>>(false);
+                reactor.post([&reactor, &frame, batch, done] {
+                    for (std::size_t i = 0; i < batch; ++i) reactor.broadcast(frame);
+                    done->store(true, std::memory_order_release);
+                    done->notify_one();
+                });
+                done->wait(false, std::memory_order_acquire);
+                bench::pause();
+                for (int fd : socks) {
+                    for (std::size_t got = 0; got < batch * kFrameBytes; ) {
+                        ssize_t r = recv(fd, sink.data(), sink.size(), 0);
+                        if (r <= 0) break;
+                        got += static_cast<std::size_t>(r);
+                    }
+                }
+                bench::resume();
+            }
+        });
+
+        for (int fd : socks) close(fd);
+        reactor.stop();
+        loop.join();
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bench::configure(argc, argv);
+    benchOrderBook();
+    benchMarketData();
+    benchParse();
+    benchQueues();
+    benchBroadcast();
+    return 0;
+}
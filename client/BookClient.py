@@ -1,22 +1,37 @@
 #!/usr/bin/env python3
 """
-BookClient: connect to market data server, parse JSON snapshots, and render
-per-symbol top-5 bid/ask in the terminal, refreshing on each snapshot.
+BookClient: connect to market data server, keep per-symbol top-5 books from
+snapshots and incremental deltas, and render them in the terminal.
 
 - Protocol: server sends concatenated JSON objects (no delimiter).
   We use JSONDecoder.raw_decode to parse incrementally from a stream buffer.
-- Format expected (tolerant):
+- Snapshot (periodic, or the reply to {"action": "snapshot"}):
   {
     "action": "market_data",
-    "event":  "market_data",
-    "data": { SYMBOL: { "buy": [...], "sell": [...] }, ... },
-    "timestamp": 169...  # optional, unix ms
+    "data": { SYMBOL: { "buy": [...], "seq": N, "sell": [...] }, ... },
+    "timestamp": 169...  # unix ms
   }
   Each level supports { "price": int, "quantity"|"volume": int }
+- Delta (only books that changed since the previous tick):
+  {
+    "action": "market_data_delta",
+    "data": [ { "symbol": S, "seq": N,
+                "changes": [ {"side": "buy"|"sell",
+                              "type": "add"|"update"|"delete",
+                              "price": int, "volume": int}, ... ] }, ... ],
+    "timestamp": 169...
+  }
+  A delta applies when its seq is the symbol's last seq + 1; older ones are
+  dropped. On a gap the client requests a snapshot and buffers deltas until
+  it arrives.
+- Subscription: by default every symbol is sent. {"action": "subscribe",
+  "symbols": [...]} narrows that to the listed symbols (each is preceded by
+  its snapshot), {"action": "unsubscribe", ...} removes some; "*" means all.
 
 Usage:
   python3 client/BookClient.py --host 127.0.0.1 --port 8000
   Optional: --frames N  Exit after N frames (default 0 = infinite)
+            --symbols A,B  Subscribe to these symbols only
 """
 from __future__ import annotations
 
@@ -78,6 +93,74 @@ def fmt_levels(levels: Any, top: int = 5) -> List[Tuple[int, int]]:
     return out
 
 
+class Books:
+    """Top-of-book state per symbol, maintained from snapshots and deltas."""
+
+    def __init__(self) -> None:
+        self.levels: Dict[str, Dict[str, Dict[int, int]]] = {}
+        self.seq: Dict[str, int] = {}
+        self.recovering = False
+        self.pending: List[Dict[str, Any]] = []  # deltas received while recovering
+        self.timestamp: Any = None
+
+    def apply_snapshot(self, msg: Dict[str, Any]) -> None:
+        for symbol, book in (msg.get("data") or {}).items():
+            book = book or {}
+            self.levels[symbol] = {
+                "buy": dict(fmt_levels(book.get("buy"), 5)),
+                "sell": dict(fmt_levels(book.get("sell"), 5)),
+            }
+            self.seq[symbol] = int(book.get("seq", 0))
+        self.timestamp = msg.get("timestamp")
+        self.recovering = False
+        pending, self.pending = self.pending, []
+        for entry in pending:
+            self.apply_entry(entry)
+
+    def apply_delta(self, msg: Dict[str, Any]) -> bool:
+        """Apply a delta frame; return False on a sequence gap."""
+        self.timestamp = msg.get("timestamp")
+        ok = True
+        for entry in msg.get("data") or []:
+            if self.recovering:
+                self.pending.append(entry)
+            elif not self.apply_entry(entry):
+                self.recovering = True
+                self.pending.append(entry)
+                ok = False
+        return ok
+
+    def apply_entry(self, entry: Dict[str, Any]) -> bool:
+        symbol = entry.get("symbol")
+        seq = int(entry.get("seq", 0))
+        last = self.seq.get(symbol, 0)
+        if seq <= last:
+            return True  # already covered by a snapshot
+        if seq != last + 1:
+            return False
+        book = self.levels.setdefault(symbol, {"buy": {}, "sell": {}})
+        for c in entry.get("changes") or []:
+            side = book.setdefault(c.get("side"), {})
+            if c.get("type") == "delete":
+                side.pop(c.get("price"), None)
+            else:
+                side[c.get("price")] = c.get("volume")
+        self.seq[symbol] = seq
+        return True
+
+    def view(self) -> Dict[str, Any]:
+        """The books in snapshot layout, best levels first."""
+        data = {}
+        for symbol, book in self.levels.items():
+            buys = sorted(book.get("buy", {}).items(), reverse=True)
+            sells = sorted(book.get("sell", {}).items())
+            data[symbol] = {
+                "buy": [{"price": p, "volume": v} for p, v in buys],
+                "sell": [{"price": p, "volume": v} for p, v in sells],
+            }
+        return {"data": data, "timestamp": self.timestamp}
+
+
 def render_frame(snapshot: Dict[str, Any]) -> None:
     data = snapshot.get("data", {})
     ts = snapshot.get("timestamp")
@@ -116,15 +199,23 @@ def render_frame(snapshot: Dict[str, Any]) -> None:
         print()
 
 
-def run(host: str, port: int, frames: int) -> int:
+def run(host: str, port: int, frames: int, symbols: List[str]) -> int:
     try:
         with socket.create_connection((host, port)) as sock:
+            if symbols:
+                sock.sendall(json.dumps({"action": "subscribe", "symbols": symbols}).encode())
             count = 0
+            books = Books()
             for obj in decode_stream(sock):
-                # Validate action/event
-                if obj.get("action") != "market_data":
+                action = obj.get("action")
+                if action == "market_data":
+                    books.apply_snapshot(obj)
+                elif action == "market_data_delta":
+                    if not books.apply_delta(obj):
+                        sock.sendall(b'{"action":"snapshot"}')
+                else:
                     continue
-                render_frame(obj)
+                render_frame(books.view())
                 count += 1
                 if frames > 0 and count >= frames:
                     break
@@ -141,8 +232,10 @@ def main(argv: list[str] | None = None) -> int:
     ap.add_argument("--host", default="127.0.0.1")
     ap.add_argument("--port", type=int, default=8000)
     ap.add_argument("--frames", type=int, default=0, help="exit after N frames (0=infinite)")
+    ap.add_argument("--symbols", default="", help="comma separated symbols to subscribe to (default all)")
     args = ap.parse_args(argv)
-    return run(args.host, args.port, args.frames)
+    symbols = [s for s in args.symbols.split(",") if s]
+    return run(args.host, args.port, args.frames, symbols)
 
 
 if __name__ == "__main__":
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""断开连接后的回收测试。
+
+连接一批客户端，每个发出一串请求后立刻断开（此时 worker 往往还在处理，客户端只能先
+退役、稍后回收），检查服务器进程打开的 fd 数量回落到测试前的水平。针对 --low-latency 自旋模式启动的服务器最有意义：
+    ./build/main --low-latency
+    python3 client/reaptest.py
+"""
+from __future__ import annotations
+
+import argparse
+import json
+import os
+import socket
+import time
+
+
+def find_server() -> int | None:
+    """按进程名找到服务器 (build/main)。"""
+    for pid in os.listdir("/proc"):
+        if not pid.isdigit():
+            continue
+        try:
+            with open(f"/proc/{pid}/comm") as f:
+                if f.read().strip() == "main":
+                    return int(pid)
+        except OSError:
+            continue
+    return None
+
+
+def fd_count(pid: int) -> int:
+    return len(os.listdir(f"/proc/{pid}/fd"))
+
+
+def main(argv: list[str] | None = None) -> int:
+    ap = argparse.ArgumentParser(description="disconnect / reclaim test client")
+    ap.add_argument("--host", default="127.0.0.1")
+    ap.add_argument("--port", type=int, default=8000)
+    ap.add_argument("--pid", type=int, default=0, help="server pid (default: the process named main)")
+    ap.add_argument("--clients", type=int, default=100)
+    ap.add_argument("--rounds", type=int, default=3)
+    ap.add_argument("--burst", type=int, default=200, help="requests sent before disconnecting")
+    ap.add_argument("--timeout", type=float, default=5.0, help="seconds to wait for the fds to be closed")
+    args = ap.parse_args(argv)
+
+    pid = args.pid or find_server()
+    if not pid:
+        print("error: server not found, pass --pid")
+        return 1
+
+    before = fd_count(pid)
+    burst = json.dumps({"action": "login", "username": "alice", "password": "secret"})
+    burst += json.dumps({"action": "snapshot"}) * args.burst
+    data = burst.encode("utf-8")
+    for _ in range(args.rounds):
+        socks = [socket.create_connection((args.host, args.port), timeout=2) for _ in range(args.clients)]
+        for s in socks:
+            s.sendall(data)
+            s.close()
+
+    # 关闭的客户端在其消息处理完后才被回收，给它一点时间
+    start = time.time()
+    after = fd_count(pid)
+    while after > before and time.time() - start < args.timeout:
+        time.sleep(0.1)
+        after = fd_count(pid)
+
+    print(f"fds before {before}, after {after} ({args.rounds} x {args.clients} connections)")
+    if after > before:
+        print("FAIL: closed clients were not reclaimed")
+        return 1
+    print("ok")
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
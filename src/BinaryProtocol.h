@@ -0,0 +1,193 @@
+// BinaryProtocol.h
+// Fixed-layout, length-prefixed binary wire format offered alongside JSON.
+// Every frame is a FrameHeader followed by `length` payload bytes. All
+// structs are packed and little-endian. Request/response type ids are the
+// MessageType values, so both protocols share MESSAGE_TYPE_LIST dispatch;
+// server-pushed events use ids from 0x8000 upwards.
+//
+// A connection picks its protocol with its first frame: kMagic selects
+// binary, anything else ('{', whitespace) selects JSON.
+
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+static_assert(std::endian::native == std::endian::little,
+              "binary protocol structs are laid out for little-endian hosts");
+
+namespace wire {
+
+constexpr std::uint8_t kMagic = 0xB5;      // first byte of every frame
+constexpr std::uint8_t kVersion = 1;
+constexpr std::uint32_t kMaxPayload = 1u << 20;
+
+// Server-pushed frame types (outside the MESSAGE_TYPE_LIST range).
+constexpr std::uint16_t kMarketData = 0x8000;
+constexpr std::uint16_t kExecutionReport = 0x8001;
+constexpr std::uint16_t kMarketDataDelta = 0x8002;
+
+#pragma pack(push, 1)
+struct FrameHeader {
+    std::uint8_t magic;
+    std::uint8_t version;
+    std::uint16_t type;     // MessageType value or server-push type
+    std::uint32_t length;   // payload bytes following the header
+    std::uint64_t seq;      // request seq, echoed back in its response
+};
+
+struct LoginRequest {
+    char username[32];      // NUL-padded
+    char password[32];
+};
+
+// Generic response payload: just the status code.
+struct StatusResponse {
+    std::int32_t status;
+};
+
+// side: 0 = buy, 1 = sell
+struct NewOrderRequest {
+    char symbol[8];
+    std::uint8_t side;
+    std::int32_t price;
+    std::int32_t quantity;
+};
+
+struct CancelOrderRequest {
+    char symbol[8];
+    std::uint64_t order_id;
+};
+
+struct ModifyOrderRequest {
+    char symbol[8];
+    std::uint64_t order_id;
+    std::int32_t price;
+    std::int32_t quantity;
+};
+
+// subscribe / unsubscribe payload: SubscriptionRequest, then symbol_count
+// NUL-padded char[8] symbol names; "*" stands for every symbol.
+struct SubscriptionRequest {
+    std::uint16_t symbol_count;
+};
+
+// stats response: StatusResponse followed by the statistics as JSON text
+// (the "stats" object of the JSON response); the request payload is empty.
+
+// Response to new/cancel/modify: OrderResponse followed by fill_count Fills
+// of the request's own order. state is an OrderState value.
+struct OrderResponse {
+    std::int32_t status;
+    std::uint64_t order_id;
+    std::uint8_t state;
+    std::int32_t leaves_qty;
+    std::uint16_t fill_count;
+};
+
+struct Fill {
+    std::int32_t price;
+    std::int32_t quantity;
+};
+
+// kExecutionReport payload: unsolicited event for a resting order.
+struct ExecutionReport {
+    char symbol[8];
+    std::uint64_t order_id;
+    std::uint8_t state;
+    std::uint8_t side;
+    std::int32_t price;
+    std::int32_t last_price;
+    std::int32_t last_qty;
+    std::int32_t leaves_qty;
+};
+
+// kMarketData (snapshot) payload: MarketDataHeader, then symbol_count times
+// { BookHeader, bid_count Levels (best first), ask_count Levels (best first) }.
+// kMarketDataDelta payload: MarketDataHeader, then symbol_count times
+// { DeltaHeader, change_count LevelChanges }.
+struct MarketDataHeader {
+    std::int64_t timestamp_ms;
+    std::uint16_t symbol_count;
+};
+
+struct BookHeader {
+    char symbol[8];         // NUL-padded
+    std::uint64_t seq;      // per-symbol sequence the snapshot is current to
+    std::uint8_t bid_count;
+    std::uint8_t ask_count;
+};
+
+struct DeltaHeader {
+    char symbol[8];         // NUL-padded
+    std::uint64_t seq;      // per-symbol sequence, +1 for every delta
+    std::uint16_t change_count;
+};
+
+struct LevelChange {
+    std::uint8_t side;      // 0 = buy, 1 = sell
+    std::uint8_t action;    // 0 = add, 1 = update, 2 = delete
+    std::int32_t price;
+    std::int32_t volume;
+};
+
+struct Level {
+    std::int32_t price;
+    std::int32_t volume;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FrameHeader) == 16);
+static_assert(sizeof(LoginRequest) == 64);
+static_assert(sizeof(MarketDataHeader) == 10);
+static_assert(sizeof(BookHeader) == 18);
+static_assert(sizeof(DeltaHeader) == 18);
+static_assert(sizeof(LevelChange) == 10);
+static_assert(sizeof(Level) == 8);
+static_assert(sizeof(NewOrderRequest) == 17);
+static_assert(sizeof(OrderResponse) == 19);
+static_assert(sizeof(ExecutionReport) == 34);
+
+template <typename T>
+inline void appendPod(std::string& out, const T& v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+// Decode a fixed-size struct from a payload; false if the size is wrong.
+template <typename T>
+inline bool readPod(std::string_view payload, T& v) {
+    if (payload.size() != sizeof(T)) return false;
+    std::memcpy(&v, payload.data(), sizeof(T));
+    return true;
+}
+
+// Start a frame whose payload is appended afterwards.
+// Returns the header offset to pass to endFrame().
+inline std::size_t beginFrame(std::string& out, std::uint16_t type, std::uint64_t seq) {
+    std::size_t at = out.size();
+    FrameHeader h{kMagic, kVersion, type, 0, seq};
+    appendPod(out, h);
+    return at;
+}
+
+// Patch the payload length of the frame started at `at`.
+inline void endFrame(std::string& out, std::size_t at) {
+    std::uint32_t len = static_cast<std::uint32_t>(out.size() - at - sizeof(FrameHeader));
+    std::memcpy(out.data() + at + offsetof(FrameHeader, length), &len, sizeof(len));
+}
+
+// NUL-padded fixed field <-> string
+inline std::string_view fixedString(const char* s, std::size_t n) {
+    return std::string_view(s, strnlen(s, n));
+}
+
+inline void copyFixed(char* dst, std::size_t n, std::string_view src) {
+    std::memset(dst, 0, n);
+    std::memcpy(dst, src.data(), src.size() < n ? src.size() : n);
+}
+
+} // namespace wire
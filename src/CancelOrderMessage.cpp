@@ -0,0 +1,36 @@
+#include "CancelOrderMessage.h"
+#include "MessagePool.h"
+#include "Client.h"
+#include "MatchingEngine.h"
+
+
+CancelOrderMessage::CancelOrderMessage(MessageType type_, json j) : OrderMessage(type_) {
+    if (j.contains("symbol")) {
+        symbol = j["symbol"].get<std::string>();
+    }
+    if (j.contains("order_id")) {
+        order_id = j["order_id"].get<std::uint64_t>();
+    } else {
+        valid_ = false;
+    }
+}
+
+MessagePtr CancelOrderMessage::fromBinary(MessageType type_, std::string_view payload, MessagePool& pool) {
+    wire::CancelOrderRequest req;
+    if (!wire::readPod(payload, req)) return nullptr;
+    MessagePtr out = pool.create<CancelOrderMessage>(type_);
+    auto* msg = static_cast<CancelOrderMessage*>(out.get());
+    msg->symbol = std::string(wire::fixedString(req.symbol, sizeof(req.symbol)));
+    msg->order_id = req.order_id;
+    return out;
+}
+
+const json& CancelOrderMessage::handle(Client& client) {
+    MatchingEngine* engine = client.matchingEngine();
+    if (valid_ && engine) {
+        result_ = engine->cancelOrder(client.sessionId(), symbol, order_id, reports_, lsn_);
+    } else {
+        valid_ = false;
+    }
+    return finish();
+}
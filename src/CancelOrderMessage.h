@@ -0,0 +1,17 @@
+#pragma once
+
+#include "OrderMessage.h"
+
+#include <memory>
+#include <string_view>
+
+class CancelOrderMessage : public OrderMessage {
+    std::uint64_t order_id = 0;
+    CancelOrderMessage(MessageType type_) : OrderMessage(type_) {}
+    friend class MessagePool;
+public:
+    CancelOrderMessage(MessageType type_, json j);
+    // Decode a wire::CancelOrderRequest payload; nullptr if malformed.
+    static MessagePtr fromBinary(MessageType type_, std::string_view payload, MessagePool& pool);
+    const json& handle(Client& client) override;
+};
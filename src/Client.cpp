@@ -1,117 +1,393 @@
 #include "Client.h"
 #include "MessageFactory.h"
+#include "EngineShards.h"
+#include "MatchingEngine.h"
+#include "MarketDataGenerator.h"
+#include "OrderLog.h"
+#include "ServerStats.h"
+#include "Tsc.h"
 
 #include <nlohmann/json.hpp>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cerrno>
 #include <cctype>
+#include <cstring>
+#include <string_view>
+#include <thread>
 
 using nlohmann::json;
 
-Client::Client(int fd_) : fd(fd_), read_buffer_(), write_buffer_() {
-    thread_ = std::thread(&Client::workProcess, this);
-}
+Client::Client(int fd_, WorkerPool& pool, BufferPool& buffers)
+    : fd(fd_), read_buffer_(buffers), messages_(kMaxMessageSize), pool_(pool) {}
 
 Client::~Client() {
-    message_queue_.close();
-    if (thread_.joinable()) {
-        thread_.join();
+    if (engine_) engine_->unregisterSession(session_id_);
+    // A scheduled drain still references this client; let it discard the
+    // backlog and finish.
+    closing_.store(true);
+    while (!idle()) {
+        std::this_thread::yield();
     }
+    if (engine_ && filtered_) engine_->countFilteredSession(false);
 }
 
-void Client::appendToReadBuffer(std::string data) {
-    read_buffer_ += data;
+void Client::retire() {
+    if (engine_) engine_->unregisterSession(session_id_);
+    closing_.store(true);
+    shutdown(fd, SHUT_RDWR);
+    read_buffer_.release();
+    stalled_.reset();
 }
 
-void Client::appendToWriteBuffer(std::string data) {
-    bool notify = false;
-    {
-        std::lock_guard<std::mutex> lock(write_mutex_);
-        if (write_buffer_.empty()) notify = true; // transition empty -> non-empty
-        write_buffer_ += std::move(data);
+void Client::appendToWriteBuffer(std::string_view data) {
+    // transition empty -> non-empty
+    if (outbound_.append(data.data(), data.size()) && writable_notifier_) {
+        writable_notifier_(fd);
     }
-    if (notify && writable_notifier_) {
+}
+
+void Client::appendToWriteBuffer(SharedBuffer data, std::uint32_t tag) {
+    if (outbound_.append(std::move(data), tag) && writable_notifier_) {
         writable_notifier_(fd);
     }
 }
 
-void Client::workProcess() {
-    std::unique_ptr<Message> msg;
-    while (1) {
-        if (!message_queue_.wait_and_pop(msg)) {
-            break;
-        }
-        if (msg) {
-            auto j = msg->handle();
-            if (!j.is_discarded()) {
-                appendToWriteBuffer(j.dump());
+void Client::replaceInWriteBuffer(std::uint32_t tag, SharedBuffer data) {
+    if (outbound_.replaceTagged(tag, std::move(data)) && writable_notifier_) {
+        writable_notifier_(fd);
+    }
+}
+
+void Client::setMatchingEngine(MatchingEngine* engine) {
+    if (engine_) {
+        engine_->unregisterSession(session_id_);
+        if (filtered_) engine_->countFilteredSession(false);
+    }
+    engine_ = engine;
+    filtered_ = false;
+    subscriptions_.setAll();
+    if (engine_) subscriptions_.resize(engine_->marketData().symbolCount());
+    session_id_ = engine_ ? engine_->registerSession(this) : 0;
+}
+
+bool Client::subscribe(std::string_view symbol) {
+    if (!engine_) return false;
+    MarketDataGenerator& mdg = engine_->marketData();
+    const bool binary = protocol_ == WireProtocol::Binary;
+    if (symbol == "*") {
+        if (subscriptions_.all()) return true;
+        subscriptions_.setAll();
+        filtered_ = false;
+        engine_->countFilteredSession(false);
+        appendToWriteBuffer(mdg.snapshot(binary));
+        return true;
+    }
+    SymbolId id = mdg.findSymbol(symbol);
+    if (id == kNoSymbol) return false;
+    if (!filtered_) {
+        subscriptions_.makeExplicit(false);
+        filtered_ = true;
+        engine_->countFilteredSession(true);
+    } else if (subscriptions_.contains(id)) {
+        return true;
+    }
+    // Bit first: a delta published after the snapshot is then broadcast to us.
+    subscriptions_.add(id);
+    appendToWriteBuffer(mdg.symbolSnapshot(id, binary));
+    return true;
+}
+
+bool Client::unsubscribe(std::string_view symbol) {
+    if (!engine_) return false;
+    SymbolId id = kNoSymbol;
+    if (symbol != "*") {
+        id = engine_->marketData().findSymbol(symbol);
+        if (id == kNoSymbol) return false;
+    }
+    if (!filtered_) {
+        subscriptions_.makeExplicit(true);
+        filtered_ = true;
+        engine_->countFilteredSession(true);
+    }
+    if (id == kNoSymbol) {
+        subscriptions_.clear();
+    } else {
+        subscriptions_.remove(id);
+    }
+    return true;
+}
+
+void Client::sendSnapshot() {
+    if (!engine_) return;
+    MarketDataGenerator& mdg = engine_->marketData();
+    const bool binary = protocol_ == WireProtocol::Binary;
+    if (subscriptions_.all()) {
+        appendToWriteBuffer(mdg.snapshot(binary));
+        return;
+    }
+    for (SymbolId id = 0; id < mdg.symbolCount(); ++id) {
+        if (subscriptions_.contains(id)) appendToWriteBuffer(mdg.symbolSnapshot(id, binary));
+    }
+}
+
+void Client::sendExecutionReport(const std::string& symbol, const ExecutionReport& r) {
+    if (protocol_ == WireProtocol::Binary) {
+        std::string out;
+        size_t at = wire::beginFrame(out, wire::kExecutionReport, 0);
+        wire::ExecutionReport er{};
+        wire::copyFixed(er.symbol, sizeof(er.symbol), symbol);
+        er.order_id = r.order_id;
+        er.state = static_cast<std::uint8_t>(r.state);
+        er.side = static_cast<std::uint8_t>(r.side);
+        er.price = r.price;
+        er.last_price = r.last_price;
+        er.last_qty = r.last_qty;
+        er.leaves_qty = r.leaves_qty;
+        wire::appendPod(out, er);
+        wire::endFrame(out, at);
+        appendToWriteBuffer(out);
+        return;
+    }
+    json j;
+    j["action"] = "execution_report";
+    j["event"] = "execution_report";
+    j["symbol"] = symbol;
+    j["order_id"] = r.order_id;
+    j["state"] = toString(r.state);
+    j["side"] = toString(r.side);
+    j["price"] = r.price;
+    j["last_price"] = r.last_price;
+    j["last_qty"] = r.last_qty;
+    j["leaves_qty"] = r.leaves_qty;
+    appendToWriteBuffer(j.dump());
+}
+
+void Client::enqueue(MessagePtr msg) {
+    if (tryQueue(msg)) return;
+    // Never wait for the drain here: that would stall the whole reactor.
+    stalled_ = std::move(msg);
+    ServerStats::instance().countReadPause();
+    retryStalled();
+}
+
+bool Client::tryQueue(MessagePtr& msg) {
+    if (!message_queue_.try_push(msg)) return false;
+    ServerStats& stats = ServerStats::instance();
+    stats.messageQueued();
+    const size_t before = pending_.fetch_add(1, std::memory_order_acq_rel);
+    stats.recordQueueDepth(before + 1);
+    if (before == 0) {
+        pool_.submit([this] { drain(); });
+    }
+    return true;
+}
+
+bool Client::retryStalled() {
+    if (!stalled_) return true;
+    // Ask first, then look for room again: with the fence in finishDrain()
+    // either the drain sees the request or we see the slots it freed, so
+    // a drain ending meanwhile cannot leave the client paused for good.
+    resume_wanted_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!tryQueue(stalled_)) return false;
+    stalled_.reset();
+    resume_wanted_.store(false, std::memory_order_relaxed);
+    return true;
+}
+
+void Client::drain() {
+    MessagePtr msg;
+    // Only take messages already counted, so pending_ never underflows.
+    size_t budget = std::min(kDrainBatch, pending_.load(std::memory_order_acquire));
+    size_t handled = 0;
+    ServerStats& stats = ServerStats::instance();
+    while (handled < budget && message_queue_.try_pop(msg)) {
+        ++handled;
+        if (!closing_.load(std::memory_order_relaxed)) {
+            stats.record(ServerStats::Stage::QueueWait, tsc::now() - msg->enqueuedAt());
+            const int shard = engine_ ? engine_->shardFor(msg->bookSymbol()) : -1;
+            if (shard >= 0) {
+                // the shard handles it and ends this drain (Task must be copyable)
+                const MessageDeleter deleter = msg.get_deleter();
+                Message* raw = msg.release();
+                engine_->shards()->post(static_cast<size_t>(shard), [this, raw, deleter, handled] {
+                    MessagePtr owned(raw, deleter);
+                    process(*owned);
+                    owned.reset();
+                    finishDrain(handled);
+                });
+                return;
             }
+            process(*msg);
         }
+        msg.reset();
     }
-} 
+    finishDrain(handled);
+}
+
+void Client::finishDrain(size_t handled) {
+    ServerStats::instance().messageDone(handled);
+    // Paused by a full queue: have the reactor resume once the backlog is
+    // down to kResumeBelow (the last drain always gets there). Before the
+    // fetch_sub, which may be our last access.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (resume_wanted_.load(std::memory_order_relaxed) &&
+        pending_.load(std::memory_order_acquire) - handled <= kResumeBelow &&
+        resume_wanted_.exchange(false, std::memory_order_relaxed) && resume_notifier_) {
+        resume_notifier_(fd);
+    }
+    // Last access to this client unless more messages arrived meanwhile.
+    if (pending_.fetch_sub(handled, std::memory_order_acq_rel) != handled) {
+        pool_.submit([this] { drain(); });
+    }
+}
+
+void Client::process(Message& msg) {
+    ServerStats& stats = ServerStats::instance();
+    const std::uint64_t started = tsc::now();
+    auto j = msg.handle(*this);
+    stats.recordHandle(msg.getType(), tsc::now() - started);
+    if (j.is_discarded()) return;
+    std::string out;
+    if (protocol_ == WireProtocol::Binary) {
+        msg.toBinary(out);
+    } else {
+        out = j.dump();
+    }
+    durable_lsn_ = std::max(durable_lsn_, msg.durableAt());
+    OrderLog* log = engine_ ? engine_->orderLog() : nullptr;
+    if (log && durable_lsn_ != 0) {
+        unsent_.fetch_add(1, std::memory_order_relaxed);
+        log->whenDurable(durable_lsn_, [this, out = std::move(out)] {
+            if (!closing_.load(std::memory_order_relaxed)) appendToWriteBuffer(out);
+            unsent_.fetch_sub(1, std::memory_order_release);
+        });
+    } else {
+        appendToWriteBuffer(out);
+    }
+    stats.record(ServerStats::Stage::Request, tsc::now() - msg.receivedAt());
+}
 
 bool Client::tryParseReadBuffer() {
-    if (read_buffer_.empty()) return false;
-    try {
-        size_t i = 0;
-        while (i < read_buffer_.size() && std::isspace(static_cast<unsigned char>(read_buffer_[i]))) i++;
-        json out = json::parse(read_buffer_.substr(i), nullptr, false);
-        if (out.is_discarded()) return false;
-
-        std::string dumped = out.dump();
-        size_t consumed = read_buffer_.find(dumped, i);
-        if (consumed == std::string::npos) {
-            // Could not locate serialized substring exactly; clear to avoid infinite loop
-            read_buffer_.clear();
-        } else {
-            read_buffer_.erase(0, consumed + dumped.size());
-        }
-        auto msg = createMessageFromJson(out);
-        if (msg) {
-            // Successfully created message
-            message_queue_.push(std::move(msg));
-        }
-        return true;
-    } catch (const json::parse_error&) {
-        return false; // incomplete
+    if (stalled_) return false;
+    if (protocol_ == WireProtocol::Unknown && !detectProtocol()) return false;
+    if (protocol_ == WireProtocol::Binary) return tryParseBinaryFrame();
+    return tryParseJsonFrame();
+}
+
+bool Client::detectProtocol() {
+    std::string_view in = read_buffer_.data();
+    size_t i = 0;
+    while (i < in.size() && std::isspace(static_cast<unsigned char>(in[i]))) i++;
+    if (i == in.size()) return false;
+    if (static_cast<std::uint8_t>(in[i]) == wire::kMagic) {
+        protocol_ = WireProtocol::Binary;
+        read_buffer_.consume(i);
+    } else {
+        protocol_ = WireProtocol::Json;
     }
+    return true;
 }
 
-std::unique_ptr<Message> Client::createMessageFromJson(json j) {
-    if (!j.contains("action")) return nullptr;
+bool Client::tryParseBinaryFrame() {
+    const std::uint64_t started = tsc::now();
+    std::string_view in = read_buffer_.data();
+    if (in.size() < sizeof(wire::FrameHeader)) return false;
+    wire::FrameHeader h;
+    std::memcpy(&h, in.data(), sizeof(h));
+    if (h.magic != wire::kMagic || h.version != wire::kVersion || h.length > wire::kMaxPayload) {
+        protocol_error_ = true;
+        read_buffer_.clear();
+        return false;
+    }
+    size_t frame_len = sizeof(h) + h.length;
+    if (in.size() < frame_len) return false;
+
+    // parsed in place; the message copies what it keeps
+    auto msg = createMessageFromBinary(h.type, in.substr(sizeof(h), h.length));
+    if (msg) {
+        msg->setSequence(h.seq);
+        stamp(*msg, started);
+        enqueue(std::move(msg));
+    }
+    read_buffer_.consume(frame_len);
+    return true;
+}
+
+bool Client::tryParseJsonFrame() {
+    const std::uint64_t started = tsc::now();
+    size_t begin = 0, end = 0;
+    std::string_view in = read_buffer_.data();
+    if (!framer_.next(in, begin, end)) {
+        // drop everything before the unfinished frame in one go
+        size_t keep_from = framer_.retained();
+        if (keep_from > 0) {
+            read_buffer_.consume(keep_from);
+            framer_.consume(keep_from);
+        }
+        return false;
+    }
+
+    std::string_view frame = in.substr(begin, end - begin);
+    json out = json::parse(frame, nullptr, false);
+    if (out.is_discarded()) return true; // malformed frame, skip it
+
+    auto msg = createMessageFromJson(std::move(out));
+    if (msg) {
+        // Successfully created message
+        stamp(*msg, started);
+        enqueue(std::move(msg));
+    }
+    return true;
+}
 
-    std::string action = j["action"];
-    std::unique_ptr<Message> msg = nullptr;
+void Client::stamp(Message& msg, std::uint64_t parse_started) {
+    const std::uint64_t now = tsc::now();
+    ServerStats::instance().record(ServerStats::Stage::Parse, now - parse_started);
+    msg.setTimestamps(parse_started, now);
+}
 
+MessagePtr Client::createMessageFromJson(json j) {
+    auto it = j.find("action");
+    if (it == j.end() || !it->is_string()) return nullptr;
+    auto type = messageTypeFromAction(it->get_ref<const std::string&>());
+    if (!type) return nullptr;
 
+    try {
+        switch (*type) {
 #define X(msg_type, msg_str) \
-if (action == msg_str) { \
-msg = std::make_unique<msg_type##Message>(MessageType::msg_type, std::move(j)); \
+        case MessageType::msg_type: \
+            return messages_.create<msg_type##Message>(MessageType::msg_type, std::move(j));
+
+        MESSAGE_TYPE_LIST
+
+#undef X
+        }
+    } catch (const json::exception&) {
+        return nullptr; // field of the wrong type
+    }
+    return nullptr;
 }
 
-MESSAGE_TYPE_LIST
+MessagePtr Client::createMessageFromBinary(std::uint16_t type, std::string_view payload) {
+    if (type >= kMessageTypeCount) return nullptr;
 
-#undef X 
+    MessagePtr msg = nullptr;
+    switch (static_cast<MessageType>(type)) {
+#define X(msg_type, msg_str) \
+    case MessageType::msg_type: \
+        msg = msg_type##Message::fromBinary(MessageType::msg_type, payload, messages_); \
+        break;
 
+    MESSAGE_TYPE_LIST
+
+#undef X
+    }
     return msg;
 }
 
 ssize_t Client::flushWriteBufferNonBlocking() {
-    std::lock_guard<std::mutex> lock(write_mutex_);
-    ssize_t total = 0;
-    while (!write_buffer_.empty()) {
-        ssize_t n = send(fd, write_buffer_.data(), write_buffer_.size(), MSG_NOSIGNAL);
-        if (n > 0) {
-            write_buffer_.erase(0, static_cast<size_t>(n));
-            total += n;
-            continue;
-        }
-        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-            break; // try later when writable
-        }
-        // error or connection closed; let server decide to close on write error
-        break;
-    }
-    return total;
+    return outbound_.flush(fd);
 }
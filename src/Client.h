@@ -1,53 +1,200 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <functional>
 #include <queue>
 #include <memory>
-#include <thread>
+#include <atomic>
 #include <mutex>
+#include "JsonFramer.h"
 #include "Message.h"
-#include "ThreadSafeQueue.h"
+#include "MessagePool.h"
+#include "OrderBook.h"
+#include "OutboundQueue.h"
+#include "ReadBuffer.h"
+#include "SubscriptionSet.h"
+#include "LockFreeQueue.h"
+#include "WorkerPool.h"
 
 /*
-        epoll 主线程                        worker 线程
+        epoll 主线程                        WorkerPool 线程 (任一)
 ----------------------------------      --------------------------
-recv -> appendToReadBuffer()    
+read(readBuffer().prepare())     
      -> tryParseReadBuffer()    
-        -> message_queue_.push(msg) 
-                                        wait_and_pop(msg)
-                                        msg->handle()
-                                        client->appendWriteBuffer()
-                                        server->notifyWritable()
+        -> enqueue(msg)
+           message_queue_.try_push(msg)
+           pending_ 0 -> 1: pool.submit(drain)
+                                        drain():
+                                          try_pop(msg)
+                                          msg->handle()
+                                          client->appendWriteBuffer()
+                                          server->notifyWritable()
+
+pending_ counts queued messages. Only the enqueue that moves it from 0
+schedules a drain, and a drain keeps ownership until it brings it back
+to 0, so at most one worker handles this client at a time and messages
+are handled in arrival order.
+
+The reactor never waits for a full queue: the message that did not fit
+is kept aside (stalled_) and the reactor stops reading from this client,
+leaving the rest to TCP flow control. Once the drains bring pending_
+down to kResumeBelow they ask the reactor (resume notifier) to queue it
+and read again, so a client pipelining faster than it is served slows
+down only itself.
+
+Execution reports for this client's resting orders can be appended from
+any thread via MatchingEngine::deliver -> sendExecutionReport().
+
+With an order log, a response goes out once the log is durable up to
+the last order event of this client's requests (OrderLog::whenDurable,
+possibly on the log thread), so responses keep their order and no order
+is acknowledged before it would survive a crash.
+
+With engine shards, an order request is handled on the shard owning its
+book: the drain stops there, posts the message to that shard, and the
+shard finishes the drain (pending_ ownership travels with it), so order
+is still kept per client.
 */
+
+class MatchingEngine;
+
+// Wire protocol of a connection, fixed by the first frame it sends.
+enum class WireProtocol { Unknown, Json, Binary };
+
 class Client {
+    // Parsed messages waiting for the worker; a full queue pauses reading.
+    static constexpr size_t kMessageQueueCapacity = 4096;
+    // Backlog a paused client must drain down to before it is read again.
+    static constexpr size_t kResumeBelow = kMessageQueueCapacity / 4;
+
     int fd;                     // file descriptor for connection
-    std::string read_buffer_;   // accumulated inbound data
-    std::string write_buffer_;  // pending outbound data
-    std::mutex write_mutex_; 
-    ThreadSafeQueue<std::unique_ptr<Message>> message_queue_;  // queue of messages to handle
-    std::thread thread_;
+    ReadBuffer read_buffer_;    // unparsed inbound data, filled by the reactor
+    JsonFramer framer_;         // frame boundaries within read_buffer_ (JSON)
+    WireProtocol protocol_ = WireProtocol::Unknown;
+    bool protocol_error_ = false;
+    OutboundQueue outbound_;    // pending outbound data
+    MessagePool messages_;      // storage of this connection's messages
+    // Reactor thread is the only producer; the drain owning pending_ the only consumer.
+    SpscQueue<MessagePtr> message_queue_{kMessageQueueCapacity};
+    MessagePtr stalled_;                // refused by the full queue; reactor only
+    std::atomic<bool> resume_wanted_{false};    // stalled: a drain should call resume_notifier_
+    WorkerPool& pool_;
+    std::atomic<size_t> pending_{0};    // messages queued but not yet handled
+    std::atomic<bool> closing_{false};  // retired or being destroyed: drop remaining messages
+    std::atomic<size_t> unsent_{0};     // responses waiting for the order log
+    std::uint64_t durable_lsn_ = 0;     // order log position of our last request; worker only
     // Notify when write buffer transitions from empty to non-empty.
     std::function<void(int)> writable_notifier_{};
+    // Ask the reactor, from a drain, to call retryStalled().
+    std::function<void(int)> resume_notifier_{};
+    MatchingEngine* engine_{nullptr};
+    std::uint32_t session_id_{0};
+    SubscriptionSet subscriptions_;     // market data symbols, every one by default
+    bool filtered_ = false;             // counted in engine_->filteredSessions(); worker only
+    std::int64_t over_limit_since_ms_ = 0;  // outbound past the soft limit since; reactor only
+    std::int64_t accepted_ms_ = 0;          // reactor only
 public:
-    explicit Client(int fd_);
+    Client(int fd_, WorkerPool& pool, BufferPool& buffers);
     ~Client();
 
-    void appendToReadBuffer(std::string data);
-    void appendToWriteBuffer(std::string data);
+    // Reactor thread only: the reactor reads into this, then parses.
+    ReadBuffer& readBuffer() { return read_buffer_; }
+    void appendToWriteBuffer(std::string_view data);
+    // Queue a reference to shared bytes (e.g. a market data tick) without copying.
+    void appendToWriteBuffer(SharedBuffer data, std::uint32_t tag = OutboundQueue::kNoTag);
+    // Reactor thread: conflate, i.e. drop queued unsent data with this tag
+    // and queue `data` in its place.
+    void replaceInWriteBuffer(std::uint32_t tag, SharedBuffer data);
+    std::size_t pendingWriteBytes() const { return outbound_.size(); }
+    std::int64_t overLimitSince() const { return over_limit_since_ms_; }
+    void setOverLimitSince(std::int64_t ms) { over_limit_since_ms_ = ms; }
+    std::int64_t acceptedAt() const { return accepted_ms_; }
+    void setAcceptedAt(std::int64_t ms) { accepted_ms_ = ms; }
+
+private:
+    // Max messages handled per drain before yielding the worker to other clients.
+    static constexpr size_t kDrainBatch = 64;
 
-    void workProcess();
+    // Record the parse time of a new message and stamp it for ServerStats.
+    static void stamp(Message& msg, std::uint64_t parse_started);
+    void enqueue(MessagePtr msg);
+    // Queue msg for the drain; false (msg untouched) if the queue is full.
+    bool tryQueue(MessagePtr& msg);
+    void drain();
+    // End of a drain that handled `handled` messages: hand pending_ back,
+    // or schedule the next drain if more arrived.
+    void finishDrain(size_t handled);
+    void process(Message& msg);
 
-    // Attempts to parse a JSON object from the read buffer.
-    // Returns true if a complete JSON object was found and consumed.
-    // Returns false if buffer is empty or contains incomplete JSON.
+    bool detectProtocol();
+    bool tryParseJsonFrame();
+    bool tryParseBinaryFrame();
+
+public:
+
+    // Attempts to parse one JSON object from the read buffer.
+    // Returns true if a complete frame was found and consumed (even if it
+    // turned out to be malformed and was dropped).
+    // Returns false if no complete frame is buffered; consumed bytes are
+    // dropped from the read buffer at that point, once per read batch.
     bool tryParseReadBuffer();
 
-    std::unique_ptr<Message> createMessageFromJson(json j);
+    MessagePtr createMessageFromJson(json j);
+    MessagePtr createMessageFromBinary(std::uint16_t type, std::string_view payload);
 
-    // Flush write buffer in non-blocking manner; return bytes sent.
+    WireProtocol protocol() const { return protocol_; }
+    // True once the peer sent an undecodable binary header; the stream
+    // cannot be resynchronised and the connection should be closed.
+    bool hasProtocolError() const { return protocol_error_; }
+
+    // Flush queued data in non-blocking manner with scatter-gather
+    // sendmsg; return bytes sent, -1 on a socket error.
     ssize_t flushWriteBufferNonBlocking();
+    bool hasPendingWrite() const { return !outbound_.empty(); }
+    // Asynchronous flush (io_uring reactor), see OutboundQueue::gather().
+    std::size_t gatherWriteBuffer(iovec* iov, std::size_t max) { return outbound_.gather(iov, max); }
+    void completeWrite(std::size_t sent) { outbound_.completeSend(sent); }
+
+    // Attach to the order entry engine and register as a session.
+    void setMatchingEngine(MatchingEngine* engine);
+    MatchingEngine* matchingEngine() const { return engine_; }
+    std::uint32_t sessionId() const { return session_id_; }
+
+    // Worker thread: change the market data subscription by symbol name,
+    // "*" meaning every symbol; false if the symbol is unknown. Newly
+    // added books are preceded by their snapshot.
+    bool subscribe(std::string_view symbol);
+    bool unsubscribe(std::string_view symbol);
+    const SubscriptionSet& subscriptions() const { return subscriptions_; }
+    // Worker thread: queue a snapshot of the subscribed books.
+    void sendSnapshot();
+
+    // Encode an unsolicited report for one of our orders in this client's protocol.
+    void sendExecutionReport(const std::string& symbol, const ExecutionReport& report);
 
     // Set callback invoked when buffer becomes non-empty after append.
     void setWritableNotifier(std::function<void(int)> cb) { writable_notifier_ = std::move(cb); }
+    // Set callback invoked (from a drain) when a paused client may be read again.
+    void setResumeNotifier(std::function<void(int)> cb) { resume_notifier_ = std::move(cb); }
+
+    // Reactor thread: the queue was full. Stop reading from the client,
+    // tryParseReadBuffer() parses nothing more, until retryStalled().
+    bool readPaused() const { return stalled_ != nullptr; }
+    // Reactor thread: queue the message the full queue refused; true if it
+    // fit and reading can resume. Otherwise the drain notifies once there
+    // is room.
+    bool retryStalled();
+
+    // Reactor thread, once the connection is closed: stop execution
+    // reports, have the worker drop the messages still queued, shut the
+    // socket down (the fd stays open until the client is destroyed) and
+    // hand the read buffer back. Does not wait for a worker inside handle().
+    void retire();
+    // No message queued or being handled and no response waiting for the
+    // order log. Once retired and idle, no other thread touches the client
+    // again and destroying it does not block.
+    bool idle() const {
+        return pending_.load(std::memory_order_acquire) == 0 && unsent_.load(std::memory_order_acquire) == 0;
+    }
 };
 
@@ -0,0 +1,70 @@
+// CounterRng.h
+// Counter-based random numbers for synthetic book generation. The n-th
+// draw of a stream is a pure function of (key, n) -- the SplitMix64 mix of
+// a Weyl sequence -- so a batch of draws has no serial dependency (the fill
+// loop vectorizes) and a stream's output does not depend on which thread
+// advances it. Not for anything security related.
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+class CounterRng {
+public:
+    using result_type = std::uint64_t;
+
+    explicit CounterRng(std::uint64_t key = 0) : key_(mix(key)) {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()() { return at(counter_++); }
+
+    // Uniform double in [0, 1).
+    double uniform() { return toUnit(at(counter_++)); }
+
+    // Uniform int in [lo, hi].
+    int uniformInt(int lo, int hi) { return lo + static_cast<int>(uniform() * (hi - lo + 1)); }
+
+    // out[i] = the next n uniforms in [0, 1), in stream order.
+    void fill(double* out, std::size_t n) {
+        const std::uint64_t base = counter_;
+        for (std::size_t i = 0; i < n; ++i) out[i] = toUnit(at(base + i));
+        counter_ += n;
+    }
+
+private:
+    static constexpr std::uint64_t mix(std::uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    std::uint64_t at(std::uint64_t n) const { return mix(key_ + (n + 1) * 0x9e3779b97f4a7c15ull); }
+
+    static double toUnit(std::uint64_t x) { return static_cast<double>(x >> 11) * 0x1.0p-53; }
+
+    std::uint64_t key_;
+    std::uint64_t counter_ = 0;
+};
+
+// Poisson variate from one uniform by inverting the CDF: walk the pmf up
+// from 0 until it covers u. Exact, O(mean) steps -- cheap for the level
+// volumes (means of a few dozen) and it keeps one draw per variate.
+inline int poissonFromUniform(double mean, double u) {
+    if (!(mean > 0)) return 0;
+    double p = std::exp(-mean);
+    double cdf = p;
+    int k = 0;
+    // the bound only matters when p underflows or u is within rounding of 1
+    const int limit = static_cast<int>(mean * 10) + 64;
+    while (u >= cdf && k < limit) {
+        ++k;
+        p *= mean / k;
+        cdf += p;
+    }
+    return k;
+}
@@ -0,0 +1,66 @@
+#include "EngineShards.h"
+
+#include "LowLatency.h"
+
+#include <algorithm>
+#include <utility>
+
+EngineShards::EngineShards(std::size_t shards, bool spin, std::vector<int> cpus)
+    : spin_(spin), cpus_(std::move(cpus)) {
+    shards = std::max<std::size_t>(shards, 1);
+    shards_.reserve(shards);
+    for (std::size_t i = 0; i < shards; ++i) shards_.push_back(std::make_unique<Shard>());
+    for (std::size_t i = 0; i < shards; ++i) {
+        shards_[i]->thread = std::thread(&EngineShards::run, this, i);
+    }
+}
+
+EngineShards::~EngineShards() {
+    stopping_.store(true, std::memory_order_release);
+    for (auto& s : shards_) s->tasks.close();
+    for (auto& s : shards_) {
+        if (s->thread.joinable()) s->thread.join();
+    }
+}
+
+void EngineShards::post(std::size_t shard, Task task) {
+    shards_[shard]->tasks.push(std::move(task));
+}
+
+void EngineShards::runOnAll(const std::function<void(std::size_t)>& fn) {
+    // The last shard still notifies after we may have seen the count and
+    // returned, so the counter must outlive this call; fn need not.
+    auto done = std::make_shared<std::atomic<std::size_t>>(0);
+    const std::size_t n = shards_.size();
+    for (std::size_t i = 0; i < n; ++i) {
+        post(i, [&fn, done, i, n] {
+            fn(i);
+            if (done->fetch_add(1, std::memory_order_acq_rel) + 1 == n) done->notify_one();
+        });
+    }
+    for (std::size_t d = done->load(std::memory_order_acquire); d != n; d = done->load(std::memory_order_acquire)) {
+        done->wait(d, std::memory_order_acquire);
+    }
+}
+
+void EngineShards::run(std::size_t index) {
+    if (index < cpus_.size()) lowlatency::pinThread(cpus_[index]);
+    MpmcQueue<Task>& tasks = shards_[index]->tasks;
+    Task task;
+    if (spin_) {
+        for (;;) {
+            if (tasks.try_pop(task)) {
+                task();
+                task = nullptr;
+                continue;
+            }
+            if (stopping_.load(std::memory_order_acquire)) break;
+            lockfree_detail::cpuRelax();
+        }
+        return;
+    }
+    while (tasks.wait_and_pop(task)) {
+        task();
+        task = nullptr;
+    }
+}
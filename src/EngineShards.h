@@ -0,0 +1,58 @@
+// EngineShards.h
+// Engine threads that own the order books. Each symbol belongs to one
+// shard (by a hash of its name, see MarketDataGenerator::setShards), and
+// everything that touches its book runs on that shard's thread: order
+// entry (handed over by the client's drain) and the timer tick's rebuild
+// and publish. A book therefore needs no lock, and books of different
+// shards are worked on in parallel.
+//
+// Each shard is a thread draining its own multi-producer task queue, in
+// submission order. Idle shards park on the queue, or spin when built for
+// low latency.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "LockFreeQueue.h"
+
+class EngineShards {
+public:
+    using Task = std::function<void()>;
+    static constexpr std::size_t kQueueCapacity = 65536;   // per shard; a full queue stalls producers
+
+    // Shard i's thread is pinned to cpus[i] when there is one.
+    explicit EngineShards(std::size_t shards, bool spin = false, std::vector<int> cpus = {});
+    // Runs every task already posted, then joins the threads.
+    ~EngineShards();
+
+    EngineShards(const EngineShards&) = delete;
+    EngineShards& operator=(const EngineShards&) = delete;
+
+    std::size_t size() const { return shards_.size(); }
+
+    // Any thread: run task on the shard's thread, after the ones posted before.
+    void post(std::size_t shard, Task task);
+
+    // Run fn(shard) on every shard and return once all have finished. Call
+    // from outside the shards.
+    void runOnAll(const std::function<void(std::size_t)>& fn);
+
+private:
+    struct Shard {
+        MpmcQueue<Task> tasks{kQueueCapacity};
+        std::thread thread;
+    };
+
+    void run(std::size_t index);
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    const bool spin_;
+    const std::vector<int> cpus_;
+    std::atomic<bool> stopping_{false};
+};
@@ -0,0 +1,76 @@
+// Histogram.h
+// Lock-free log-linear (HDR style) histogram of non-negative 64-bit values.
+// Values below 2 * 2^kSubBits get a bucket each; above that every power of
+// two is split into 2^kSubBits buckets, so a reported value is within about
+// 3% of the recorded ones. Any thread may record (a few relaxed atomic
+// adds) while another reads; readers see a slightly stale but usable view.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+class Histogram {
+public:
+    void record(std::uint64_t v) {
+        counts_[index(v)].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(v, std::memory_order_relaxed);
+        std::uint64_t m = max_.load(std::memory_order_relaxed);
+        while (v > m && !max_.compare_exchange_weak(m, v, std::memory_order_relaxed)) {
+        }
+    }
+
+    std::uint64_t count() const {
+        std::uint64_t n = 0;
+        for (const auto& c : counts_) n += c.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    std::uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    std::uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the q-quantile (0 < q <= 1), capped at max().
+    std::uint64_t percentile(double q) const {
+        std::array<std::uint64_t, kBuckets> snap;
+        std::uint64_t total = 0;
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            snap[i] = counts_[i].load(std::memory_order_relaxed);
+            total += snap[i];
+        }
+        if (total == 0) return 0;
+        const auto target = std::max<std::uint64_t>(
+            1, static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(total))));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            seen += snap[i];
+            if (seen >= target) return std::min(upperBound(i), max());
+        }
+        return max();
+    }
+
+private:
+    static constexpr int kSubBits = 5;
+    static constexpr std::size_t kSub = std::size_t{1} << kSubBits;
+    static constexpr std::size_t kBuckets = (64 - kSubBits + 1) * kSub;
+
+    static std::size_t index(std::uint64_t v) {
+        if (v < 2 * kSub) return static_cast<std::size_t>(v);
+        const int shift = std::bit_width(v) - 1 - kSubBits;
+        return static_cast<std::size_t>(shift + 1) * kSub + static_cast<std::size_t>((v >> shift) - kSub);
+    }
+
+    static std::uint64_t upperBound(std::size_t i) {
+        if (i < 2 * kSub) return i;
+        const int shift = static_cast<int>(i / kSub) - 1;
+        return ((i % kSub + kSub + 1) << shift) - 1;
+    }
+
+    std::array<std::atomic<std::uint64_t>, kBuckets> counts_{};
+    std::atomic<std::uint64_t> sum_{0};
+    std::atomic<std::uint64_t> max_{0};
+};
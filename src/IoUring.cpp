@@ -0,0 +1,170 @@
+#include "IoUring.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+static int ioUringSetup(unsigned entries, io_uring_params* p) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int ioUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+static int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+template <typename T>
+static T* at(void* base, unsigned offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+IoUring::~IoUring() {
+    // closing the ring cancels whatever is still in flight
+    if (fd_ >= 0) close(fd_);
+    if (buffers_) munmap(buffers_, buffers_size_);
+    if (buf_ring_) munmap(buf_ring_, buf_ring_size_);
+    if (sqes_) munmap(sqes_, sqes_size_);
+    if (cq_ring_ && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_) munmap(sq_ring_, sq_ring_size_);
+}
+
+bool IoUring::init(unsigned sq_entries, unsigned cq_entries) {
+    io_uring_params p{};
+    // completions are reaped by the submitter only, inside io_uring_enter
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_SINGLE_ISSUER |
+              IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_R_DISABLED;
+    p.cq_entries = cq_entries;
+    fd_ = ioUringSetup(sq_entries, &p);
+    if (fd_ < 0 && errno == EINVAL) {
+        // before 6.1: no single issuer / deferred task work
+        p = io_uring_params{};
+        p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_R_DISABLED;
+        p.cq_entries = cq_entries;
+        fd_ = ioUringSetup(sq_entries, &p);
+    }
+    if (fd_ < 0) {
+        std::perror("io_uring_setup");
+        return false;
+    }
+
+    sq_ring_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                    IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        sq_ring_ = nullptr;
+        std::perror("io_uring mmap sq");
+        return false;
+    }
+    cq_ring_ = single ? sq_ring_
+                      : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                             IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+        cq_ring_ = nullptr;
+        std::perror("io_uring mmap cq");
+        return false;
+    }
+    sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                      IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        std::perror("io_uring mmap sqes");
+        return false;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    sq_head_ = at<unsigned>(sq_ring_, p.sq_off.head);
+    sq_tail_ = at<unsigned>(sq_ring_, p.sq_off.tail);
+    sq_mask_ = *at<unsigned>(sq_ring_, p.sq_off.ring_mask);
+    sq_entries_ = p.sq_entries;
+    // entries are used in ring order, so the indirection array is the identity
+    unsigned* array = at<unsigned>(sq_ring_, p.sq_off.array);
+    for (unsigned i = 0; i < sq_entries_; ++i) array[i] = i;
+    sqe_tail_ = *sq_tail_;
+
+    cq_head_ = at<unsigned>(cq_ring_, p.cq_off.head);
+    cq_tail_ = at<unsigned>(cq_ring_, p.cq_off.tail);
+    cq_mask_ = *at<unsigned>(cq_ring_, p.cq_off.ring_mask);
+    cqes_ = at<io_uring_cqe>(cq_ring_, p.cq_off.cqes);
+    return true;
+}
+
+bool IoUring::enable() {
+    if (ioUringRegister(fd_, IORING_REGISTER_ENABLE_RINGS, nullptr, 0) < 0) {
+        std::perror("io_uring enable");
+        return false;
+    }
+    return true;
+}
+
+bool IoUring::setupBuffers(std::uint16_t group, unsigned count, unsigned size) {
+    buf_ring_size_ = count * sizeof(io_uring_buf);
+    void* ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        std::perror("io_uring buffer ring");
+        return false;
+    }
+    // The entries start at offset 0, tail overlaying bufs[0].resv. Not
+    // through io_uring_buf_ring::bufs: compiled as C++, the header's empty
+    // struct in front of the flexible array takes a byte and moves it.
+    buf_ring_ = static_cast<io_uring_buf*>(ring);
+    buf_ring_tail_ = &static_cast<io_uring_buf_ring*>(ring)->tail;
+    buffers_size_ = static_cast<std::size_t>(count) * size;
+    void* bufs = mmap(nullptr, buffers_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bufs == MAP_FAILED) {
+        std::perror("io_uring buffers");
+        return false;
+    }
+    buffers_ = static_cast<char*>(bufs);
+    buffer_size_ = size;
+    buf_mask_ = count - 1;
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<std::uint64_t>(buf_ring_);
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (ioUringRegister(fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        std::perror("io_uring register buffer ring (needs Linux 5.19)");
+        return false;
+    }
+    for (unsigned i = 0; i < count; ++i) recycleBuffer(static_cast<std::uint16_t>(i));
+    return true;
+}
+
+void IoUring::recycleBuffer(std::uint16_t bid) {
+    io_uring_buf& b = buf_ring_[buf_tail_ & buf_mask_];
+    b.addr = reinterpret_cast<std::uint64_t>(buffer(bid));
+    b.len = buffer_size_;
+    b.bid = bid;
+    ++buf_tail_;
+    __atomic_store_n(buf_ring_tail_, buf_tail_, __ATOMIC_RELEASE);
+}
+
+io_uring_sqe* IoUring::sqe() {
+    if (sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+        submitAndWait(0);
+        if (sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) return nullptr;
+    }
+    io_uring_sqe* e = &sqes_[sqe_tail_ & sq_mask_];
+    std::memset(e, 0, sizeof(*e));
+    ++sqe_tail_;
+    return e;
+}
+
+int IoUring::submitAndWait(unsigned wait_nr) {
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+    const unsigned pending = sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    // GETEVENTS even for wait_nr 0: deferred task work only runs with it
+    const int r = ioUringEnter(fd_, pending, wait_nr, IORING_ENTER_GETEVENTS);
+    return r < 0 ? -errno : r;
+}
@@ -0,0 +1,82 @@
+// IoUring.h
+// Minimal io_uring ring over the raw syscalls (no liburing): one
+// submission / completion queue pair plus an optional provided buffer
+// ring, which multishot receives pick their buffers from. Owned and used
+// by a single thread, the UringReactor running it.
+
+#pragma once
+
+#include <linux/io_uring.h>
+
+#include <cstddef>
+#include <cstdint>
+
+class IoUring {
+public:
+    IoUring() = default;
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Create and map the rings. They start disabled; enable() them from the
+    // thread that will submit (the ring is single issuer where the kernel
+    // supports it). Return false on error (reported with perror).
+    bool init(unsigned sq_entries, unsigned cq_entries);
+    bool enable();
+
+    // Register `count` (a power of two) buffers of `size` bytes each as
+    // provided buffer group `group`.
+    bool setupBuffers(std::uint16_t group, unsigned count, unsigned size);
+    char* buffer(std::uint16_t bid) const { return buffers_ + static_cast<std::size_t>(bid) * buffer_size_; }
+    // Hand a buffer the kernel filled back to the group.
+    void recycleBuffer(std::uint16_t bid);
+
+    // Next submission entry, zeroed; flushes the queue to the kernel first
+    // when it is full.
+    io_uring_sqe* sqe();
+    // Submit everything queued, post the completions that are due and wait
+    // until there are at least wait_nr. Returns the number submitted or -errno.
+    int submitAndWait(unsigned wait_nr);
+
+    // Visit the completions that are ready, then release them. f may queue
+    // new submissions.
+    template <typename F>
+    unsigned forEachCompletion(F&& f) {
+        unsigned head = *cq_head_;
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        unsigned n = 0;
+        for (; head != tail; ++head, ++n) f(cqes_[head & cq_mask_]);
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        return n;
+    }
+
+private:
+    int fd_ = -1;
+    void* sq_ring_ = nullptr;
+    void* cq_ring_ = nullptr;
+    std::size_t sq_ring_size_ = 0;
+    std::size_t cq_ring_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    std::size_t sqes_size_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sqe_tail_ = 0;      // entries handed out; published on submit
+
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    io_uring_buf* buf_ring_ = nullptr;
+    std::uint16_t* buf_ring_tail_ = nullptr;
+    std::size_t buf_ring_size_ = 0;
+    char* buffers_ = nullptr;
+    std::size_t buffers_size_ = 0;
+    unsigned buffer_size_ = 0;
+    unsigned buf_mask_ = 0;
+    std::uint16_t buf_tail_ = 0;
+};
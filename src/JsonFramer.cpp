@@ -0,0 +1,63 @@
+#include "JsonFramer.h"
+
+bool JsonFramer::next(std::string_view buf, std::size_t& begin, std::size_t& end) {
+    const char* p = buf.data();
+    const std::size_t n = buf.size();
+    while (pos_ < n) {
+        char c = p[pos_++];
+        if (start_ == npos) {
+            // between frames: wait for an opening bracket, skip anything else
+            if (c == '{' || c == '[') {
+                start_ = pos_ - 1;
+                depth_ = 1;
+            }
+            continue;
+        }
+        if (in_string_) {
+            if (escape_) {
+                escape_ = false;
+            } else if (c == '\\') {
+                escape_ = true;
+            } else if (c == '"') {
+                in_string_ = false;
+            }
+            continue;
+        }
+        switch (c) {
+        case '"':
+            in_string_ = true;
+            break;
+        case '{':
+        case '[':
+            ++depth_;
+            break;
+        case '}':
+        case ']':
+            if (--depth_ == 0) {
+                begin = start_;
+                end = pos_;
+                start_ = npos;
+                return true;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
+void JsonFramer::consume(std::size_t n) {
+    pos_ = pos_ > n ? pos_ - n : 0;
+    if (start_ != npos) {
+        start_ = start_ > n ? start_ - n : 0;
+    }
+}
+
+void JsonFramer::reset() {
+    pos_ = 0;
+    start_ = npos;
+    depth_ = 0;
+    in_string_ = false;
+    escape_ = false;
+}
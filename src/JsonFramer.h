@@ -0,0 +1,36 @@
+// JsonFramer.h
+// Incremental framer for a stream of concatenated JSON values (no delimiter).
+// It scans each byte once, tracking nesting depth and string/escape state,
+// and reports the exact [begin, end) range of every complete top-level value.
+
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+class JsonFramer {
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    // Scan buf from the saved cursor. On a complete top-level object/array,
+    // store its byte range in [begin, end) and return true; the cursor moves
+    // past it. Return false when more bytes are needed.
+    // Stray bytes outside any value are skipped.
+    bool next(std::string_view buf, std::size_t& begin, std::size_t& end);
+
+    // The caller dropped n bytes from the front of its buffer; rebase offsets.
+    void consume(std::size_t n);
+
+    // Offset of the first byte that still belongs to an unfinished frame
+    // (or the cursor if idle). Everything before it may be discarded.
+    std::size_t retained() const { return start_ == npos ? pos_ : start_; }
+
+    void reset();
+
+private:
+    std::size_t pos_ = 0;       // next byte to scan
+    std::size_t start_ = npos;  // start of current frame, npos if idle
+    int depth_ = 0;
+    bool in_string_ = false;
+    bool escape_ = false;
+};
@@ -0,0 +1,120 @@
+// JsonWriter.h
+// Streams JSON text straight into a caller's string, without building a
+// nlohmann DOM first. Output matches json::dump() byte for byte as long as
+// the caller writes object keys in sorted order (nlohmann keeps objects in
+// a std::map): no whitespace, integers in plain decimal, strings escaped
+// the same way.
+//
+// Used on the market data hot path; the target string is typically reused
+// across ticks so its capacity is kept.
+
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out_(out) {}
+
+    JsonWriter& beginObject() { open('{'); return *this; }
+    JsonWriter& endObject() { close('}'); return *this; }
+    JsonWriter& beginArray() { open('['); return *this; }
+    JsonWriter& endArray() { close(']'); return *this; }
+
+    JsonWriter& key(std::string_view k) {
+        separate();
+        string(k);
+        out_ += ':';
+        after_key_ = true;
+        return *this;
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+    JsonWriter& value(T v) {
+        separate();
+        char buf[24];
+        auto res = std::to_chars(buf, buf + sizeof(buf), v);
+        out_.append(buf, res.ptr);
+        return *this;
+    }
+
+    JsonWriter& value(std::string_view s) {
+        separate();
+        string(s);
+        return *this;
+    }
+    JsonWriter& value(const char* s) { return value(std::string_view(s)); }
+
+    JsonWriter& null() {
+        separate();
+        out_ += "null";
+        return *this;
+    }
+
+    // A value that is already valid JSON text (e.g. a cached fragment).
+    JsonWriter& raw(std::string_view json) {
+        separate();
+        out_ += json;
+        return *this;
+    }
+
+    // Append s as a quoted, escaped JSON string.
+    static void appendString(std::string& out, std::string_view s) {
+        static constexpr char kHex[] = "0123456789abcdef";
+        out += '"';
+        std::size_t plain = 0;   // start of the run that needs no escaping
+        for (std::size_t i = 0; i < s.size(); ++i) {
+            const auto c = static_cast<unsigned char>(s[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') continue;
+            out.append(s.data() + plain, i - plain);
+            plain = i + 1;
+            switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                out += "\\u00";
+                out += kHex[c >> 4];
+                out += kHex[c & 0xF];
+            }
+        }
+        out.append(s.data() + plain, s.size() - plain);
+        out += '"';
+    }
+
+private:
+    void open(char c) {
+        separate();
+        out_ += c;
+        first_ = true;
+    }
+
+    void close(char c) {
+        out_ += c;
+        first_ = false;
+    }
+
+    // Comma between members, except right after '{', '[' or a key.
+    void separate() {
+        if (after_key_) {
+            after_key_ = false;
+        } else if (!first_) {
+            out_ += ',';
+        }
+        first_ = false;
+    }
+
+    void string(std::string_view s) { appendString(out_, s); }
+
+    std::string& out_;
+    bool first_ = true;       // nothing written yet at the current level
+    bool after_key_ = false;  // the next value belongs to a key
+};
@@ -0,0 +1,275 @@
+// LockFreeQueue.h
+// Bounded lock-free alternatives to ThreadSafeQueue with the same
+// push / wait_and_pop / close interface (plus try_push / try_pop):
+//
+//   SpscQueue<T>  single producer, single consumer ring
+//   MpmcQueue<T>  multi producer, multi consumer ring (Vyukov's sequence
+//                 numbered cells)
+//
+// Producers never take a lock or make a syscall unless a consumer is
+// actually asleep. A consumer in wait_and_pop spins for a while, then
+// parks on a 32-bit futex word (std::atomic::wait) that every push bumps,
+// so an idle queue burns no CPU. push() on a full queue spins/yields until
+// a slot frees up.
+//
+// "Single consumer" means one at a time: handing the consumer role to
+// another thread is fine as long as the handoff itself synchronizes.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace lockfree_detail {
+
+constexpr std::size_t kCacheLine = 64;
+constexpr int kSpinIterations = 256;
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// Backoff for a producer facing a full ring: pause briefly, then give the
+// CPU away so a consumer sharing the core can make room.
+inline void backoff(int& spins) {
+    if (++spins < kSpinIterations) cpuRelax();
+    else std::this_thread::yield();
+}
+
+inline std::size_t roundUpPow2(std::size_t n) {
+    std::size_t p = 2;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+// Park/unpark shared by both queues. signal_ is bumped on every push and
+// close; sleepers_ lets producers skip the futex wake when nobody waits.
+class Waiter {
+public:
+    std::uint32_t epoch() const { return signal_.load(std::memory_order_acquire); }
+
+    void notify(bool all) {
+        signal_.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+            if (all) signal_.notify_all(); else signal_.notify_one();
+        }
+    }
+
+    // Sleep until the epoch moves past `seen`.
+    void wait(std::uint32_t seen) {
+        sleepers_.fetch_add(1, std::memory_order_seq_cst);
+        if (signal_.load(std::memory_order_seq_cst) == seen) {
+            signal_.wait(seen, std::memory_order_acquire);
+        }
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+private:
+    alignas(kCacheLine) std::atomic<std::uint32_t> signal_{0};
+    std::atomic<std::uint32_t> sleepers_{0};
+};
+
+// Spin, then park, until try_pop succeeds or the queue is closed and empty.
+template <typename Queue, typename T>
+bool waitAndPop(Queue& q, Waiter& w, const std::atomic<bool>& closed, T& value) {
+    for (int i = 0; i < kSpinIterations; ++i) {
+        if (q.try_pop(value)) return true;
+        if (closed.load(std::memory_order_acquire)) return q.try_pop(value);
+        cpuRelax();
+    }
+    for (;;) {
+        std::uint32_t seen = w.epoch();
+        if (q.try_pop(value)) return true;
+        if (closed.load(std::memory_order_acquire)) return q.try_pop(value);
+        w.wait(seen);
+    }
+}
+
+} // namespace lockfree_detail
+
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(std::size_t capacity = 1024)
+        : capacity_(lockfree_detail::roundUpPow2(capacity)), mask_(capacity_ - 1),
+          slots_(static_cast<Slot*>(::operator new[](capacity_ * sizeof(Slot), std::align_val_t{alignof(Slot)}))) {}
+
+    ~SpscQueue() {
+        T tmp;
+        while (try_pop(tmp)) {}
+        ::operator delete[](slots_, std::align_val_t{alignof(Slot)});
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    bool try_push(T& value) {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == capacity_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == capacity_) return false;
+        }
+        new (&slots_[tail & mask_].storage) T(std::move(value));
+        tail_.store(tail + 1, std::memory_order_release);
+        waiter_.notify(false);
+        return true;
+    }
+
+    void push(T value) {
+        int spins = 0;
+        while (!try_push(value)) lockfree_detail::backoff(spins);
+    }
+
+    bool try_pop(T& value) {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) return false;
+        }
+        T* slot = std::launder(reinterpret_cast<T*>(&slots_[head & mask_].storage));
+        value = std::move(*slot);
+        slot->~T();
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool wait_and_pop(T& value) {
+        return lockfree_detail::waitAndPop(*this, waiter_, closed_, value);
+    }
+
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        waiter_.notify(true);
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Slot {
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    const std::size_t capacity_;
+    const std::size_t mask_;
+    Slot* slots_;
+
+    // consumer side
+    alignas(lockfree_detail::kCacheLine) std::atomic<std::size_t> head_{0};
+    std::size_t tail_cache_{0};
+    // producer side
+    alignas(lockfree_detail::kCacheLine) std::atomic<std::size_t> tail_{0};
+    std::size_t head_cache_{0};
+
+    std::atomic<bool> closed_{false};
+    lockfree_detail::Waiter waiter_;
+};
+
+template <typename T>
+class MpmcQueue {
+public:
+    explicit MpmcQueue(std::size_t capacity = 1024)
+        : capacity_(lockfree_detail::roundUpPow2(capacity)), mask_(capacity_ - 1),
+          cells_(static_cast<Cell*>(::operator new[](capacity_ * sizeof(Cell), std::align_val_t{alignof(Cell)}))) {
+        for (std::size_t i = 0; i < capacity_; ++i) {
+            new (&cells_[i].seq) std::atomic<std::size_t>(i);
+        }
+    }
+
+    ~MpmcQueue() {
+        T tmp;
+        while (try_pop(tmp)) {}
+        for (std::size_t i = 0; i < capacity_; ++i) cells_[i].seq.~atomic();
+        ::operator delete[](cells_, std::align_val_t{alignof(Cell)});
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    bool try_push(T& value) {
+        std::size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            std::size_t seq = cell.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    new (&cell.storage) T(std::move(value));
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    waiter_.notify(false);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // full
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void push(T value) {
+        int spins = 0;
+        while (!try_push(value)) lockfree_detail::backoff(spins);
+    }
+
+    bool try_pop(T& value) {
+        std::size_t pos = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            std::size_t seq = cell.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    T* slot = std::launder(reinterpret_cast<T*>(&cell.storage));
+                    value = std::move(*slot);
+                    slot->~T();
+                    cell.seq.store(pos + capacity_, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // empty
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool wait_and_pop(T& value) {
+        return lockfree_detail::waitAndPop(*this, waiter_, closed_, value);
+    }
+
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        waiter_.notify(true);
+    }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    const std::size_t capacity_;
+    const std::size_t mask_;
+    Cell* cells_;
+
+    alignas(lockfree_detail::kCacheLine) std::atomic<std::size_t> head_{0};
+    alignas(lockfree_detail::kCacheLine) std::atomic<std::size_t> tail_{0};
+
+    std::atomic<bool> closed_{false};
+    lockfree_detail::Waiter waiter_;
+};
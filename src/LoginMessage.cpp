@@ -1,4 +1,5 @@
 #include "LoginMessage.h"
+#include "MessagePool.h"
 
 
 LoginMessage::LoginMessage(MessageType type_, json j) : Message(type_) {
@@ -10,7 +11,19 @@ LoginMessage::LoginMessage(MessageType type_, json j) : Message(type_) {
     }
 }
 
-const json& LoginMessage::handle() {
+LoginMessage::LoginMessage(MessageType type_, std::string username_, std::string password_)
+    : Message(type_), username(std::move(username_)), password(std::move(password_)) {}
+
+MessagePtr LoginMessage::fromBinary(MessageType type_, std::string_view payload, MessagePool& pool) {
+    wire::LoginRequest req;
+    if (!wire::readPod(payload, req)) return nullptr;
+    return pool.create<LoginMessage>(
+        type_,
+        std::string(wire::fixedString(req.username, sizeof(req.username))),
+        std::string(wire::fixedString(req.password, sizeof(req.password))));
+}
+
+const json& LoginMessage::handle(Client&) {
     if (username.empty() || password.empty()) {
         status_code_ = 403;
     } else {
@@ -2,11 +2,18 @@
 
 #include "Message.h"
 
+#include <memory>
+#include <string_view>
+
 class LoginMessage : public Message {
     std::string username;
     std::string password;
+    LoginMessage(MessageType type_, std::string username_, std::string password_);
+    friend class MessagePool;
 public:
     LoginMessage(MessageType type_, json j);
-    const json& handle() override;
+    // Decode a wire::LoginRequest payload; nullptr if malformed.
+    static MessagePtr fromBinary(MessageType type_, std::string_view payload, MessagePool& pool);
+    const json& handle(Client& client) override;
     void toJson() override;
 };
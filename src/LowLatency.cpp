@@ -0,0 +1,61 @@
+#include "LowLatency.h"
+
+#include <malloc.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace lowlatency {
+
+bool pinThread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        std::fprintf(stderr, "cpu %d out of range\n", cpu);
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    // returns the error instead of setting errno
+    const int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        std::fprintf(stderr, "cannot pin a thread to cpu %d: %s\n", cpu, std::strerror(err));
+        return false;
+    }
+    return true;
+}
+
+bool tuneSocket(int fd, int busy_poll_us) {
+    int yes = 1;
+    bool ok = setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes)) == 0;
+    if (busy_poll_us > 0) {
+        ok = setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us)) == 0 && ok;
+    }
+    return ok;
+}
+
+// Touch the stack below the caller so the pages exist (and, locked, stay).
+static void prefaultStack(std::size_t bytes) {
+    volatile char* stack = static_cast<volatile char*>(__builtin_alloca(bytes));
+    for (std::size_t i = 0; i < bytes; i += 4096) stack[i] = 0;
+}
+
+bool lockMemory(std::size_t stack_bytes) {
+    // Freed memory stays in the heap (no trimming, no per-allocation
+    // mmap), so a later allocation reuses resident pages.
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+        std::perror("mlockall");
+        return false;
+    }
+    prefaultStack(stack_bytes);
+    return true;
+}
+
+} // namespace lowlatency
@@ -0,0 +1,29 @@
+// LowLatency.h
+// Process and thread tuning of the low-latency mode (see
+// ServerConfig::low_latency): pinning threads to cores, socket options of
+// client connections, and keeping memory resident so the hot path never
+// takes a page fault.
+
+#pragma once
+
+#include <cstddef>
+
+namespace lowlatency {
+
+// Pin the calling thread to one core. Returns false (reported) on error;
+// the thread keeps floating then.
+bool pinThread(int cpu);
+
+// TCP_NODELAY, plus SO_BUSY_POLL of busy_poll_us (> 0) so a receive
+// spins on the device queue instead of sleeping. Returns false if an
+// option was refused (SO_BUSY_POLL past net.core.busy_read needs
+// CAP_NET_ADMIN); nothing is reported.
+bool tuneSocket(int fd, int busy_poll_us);
+
+// Keep freed heap memory in the process instead of handing it back to the
+// kernel, lock every current and future mapping (populating it) and fault
+// in stack_bytes of the calling thread's stack. Returns false (reported)
+// if the memory could not be locked, e.g. past RLIMIT_MEMLOCK.
+bool lockMemory(std::size_t stack_bytes = 512 * 1024);
+
+} // namespace lowlatency
@@ -1,4 +1,12 @@
 #include "MarketDataGenerator.h"
+#include "BinaryProtocol.h"
+#include "EngineShards.h"
+#include "OrderLog.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 
 static inline int64_t getCurrentTimeInMilliseconds() {
     return std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -6,34 +14,425 @@ static inline int64_t getCurrentTimeInMilliseconds() {
         .count();
 }
 
-MarketDataGenerator::MarketDataGenerator() {
-    order_books["A"] = OrderBook(100, 50);
+MarketDataGenerator::MarketDataGenerator(std::size_t symbols, std::uint64_t seed) : seed_(seed) {
+    symbols = std::min(std::max<std::size_t>(symbols, 1), kMaxSymbols);
+    symbols_.reserve(symbols);
+    addSymbol("A", 100, 50);
+    char name[16];
+    for (std::size_t i = 1; i < symbols; ++i) {
+        std::snprintf(name, sizeof(name), "S%05zu", i);
+        addSymbol(name, 100, 50);
+    }
+}
+
+SymbolId MarketDataGenerator::addSymbol(const std::string& name, int fair_price, int max_volume) {
+    if (symbols_.size() >= kMaxSymbols || ids_.count(name)) return kNoSymbol;
+    SymbolId id = static_cast<SymbolId>(symbols_.size());
+
+    Symbol s;
+    s.name = name;
+    JsonWriter::appendString(s.key, name);
+    // distinct non-zero key per symbol (CounterRng mixes it further)
+    const std::uint64_t key = seed_ ? (seed_ + 0x9E3779B97F4A7C15ull * (id + 1)) | 1 : 0;
+    s.book = std::make_unique<OrderBook>(fair_price, max_volume, key);
+    if (shards_) s.shard = static_cast<std::uint32_t>(std::hash<std::string>{}(name) % shards_->size());
+    symbols_.push_back(std::move(s));
+    ids_.emplace(name, id);
+
+    auto pos = std::lower_bound(sorted_.begin(), sorted_.end(), name,
+                                [this](SymbolId a, const std::string& n) { return symbols_[a].name < n; });
+    sorted_.insert(pos, id);
+    due_.emplace(0, id);    // first timer builds it
+    snapshot_json_.reset();
+    snapshot_binary_.reset();
+    return id;
+}
+
+SymbolId MarketDataGenerator::findSymbol(std::string_view name) const {
+    auto it = ids_.find(name);
+    return it == ids_.end() ? kNoSymbol : it->second;
+}
+
+void MarketDataGenerator::setShards(EngineShards* shards) {
+    shards_ = shards;
+    shard_ticks_ = std::vector<ShardTick>(shards ? shards->size() : 0);
+    for (Symbol& s : symbols_) {
+        s.shard = shards ? static_cast<std::uint32_t>(std::hash<std::string>{}(s.name) % shards->size()) : 0;
+    }
+}
+
+void MarketDataGenerator::markDirty(SymbolId id) {
+    Symbol& s = symbols_[id];
+    if (s.dirty) return;
+    s.dirty = true;
+    if (shards_) {
+        shard_ticks_[s.shard].dirty.push_back(id);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(dirty_mutex_);
+    dirty_.push_back(id);
+}
+
+void MarketDataGenerator::publish(SymbolId id, std::vector<Delta>& deltas, std::vector<LevelChange>& changes) {
+    Symbol& s = symbols_[id];
+    s.dirty = false;
+    PriceLevel bids[kTopLevels], asks[kTopLevels];
+    std::size_t nb = s.book->getTopBids(bids, kTopLevels);
+    std::size_t na = s.book->getTopAsks(asks, kTopLevels);
+
+    std::size_t first = changes.size();
+    diffLevels(Side::Buy, s.bids, s.bid_count, bids, nb, changes);
+    diffLevels(Side::Sell, s.asks, s.ask_count, asks, na, changes);
+    if (changes.size() == first) return;
+
+    deltas.push_back({id, ++s.seq, first, changes.size() - first});
+    std::copy(bids, bids + nb, s.bids);
+    std::copy(asks, asks + na, s.asks);
+    s.bid_count = static_cast<std::uint8_t>(nb);
+    s.ask_count = static_cast<std::uint8_t>(na);
+    s.fragment_stale = true;
+    s.snapshot_json.reset();
+    s.snapshot_binary.reset();
+}
+
+void MarketDataGenerator::renderFragment(Symbol& s) {
+    s.fragment.clear();
+    JsonWriter w(s.fragment);
+    w.beginObject();
+    writeLevels(w.key("buy"), s.bids, s.bid_count);
+    writeLevels(w.key("sell"), s.asks, s.ask_count);
+    w.key("seq").value(s.seq);
+    w.endObject();
+    s.fragment_stale = false;
+}
+
+
+MarketDataGenerator::Frame MarketDataGenerator::makeMarketData() {
+    std::lock_guard<std::mutex> guard(snapshot_mutex_);
+    now_ms_ = clock_ ? clock_() : getCurrentTimeInMilliseconds();
+    ++seq_;
+    deltas_.clear();
+    changes_.clear();
+
+    // 1) books whose tick time has come: rebuild (in parallel when there
+    // are many; each book has its own random stream), then reschedule and
+    // publish in due order
+    due_now_.clear();
+    while (!due_.empty() && due_.top().first <= now_ms_) {
+        due_now_.push_back(due_.top().second);
+        due_.pop();
+    }
+    if (shards_) {
+        tickShards();
+        return finishTick();
+    }
+    auto rebuild = [this](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            Symbol& s = symbols_[due_now_[i]];
+            std::lock_guard<std::mutex> lock(s.book->mutex());
+            s.book->rebuildAround(s.reports);
+            if (order_log_ && !s.reports.empty()) order_log_->append(due_now_[i], s.reports);
+            s.book->setNextTickTime(now_ms_);
+        }
+    };
+    if (pool_ && due_now_.size() >= kParallelRebuildMin) {
+        pool_->parallelFor(due_now_.size(), kRebuildGrain, rebuild);
+    } else {
+        rebuild(0, due_now_.size());
+    }
+    for (SymbolId id : due_now_) {
+        Symbol& s = symbols_[id];
+        {
+            std::lock_guard<std::mutex> lock(s.book->mutex());
+            due_.emplace(s.book->getNextTickTime(), id);
+            publish(id, deltas_, changes_);
+        }
+        if (!s.reports.empty()) {
+            if (execution_sink_) execution_sink_(s.name, s.reports);
+            s.reports.clear();
+        }
+    }
+
+    // 2) books touched by order entry since the last tick
+    std::vector<SymbolId> dirty;
+    {
+        std::lock_guard<std::mutex> lock(dirty_mutex_);
+        dirty.swap(dirty_);
+    }
+    for (SymbolId id : dirty) {
+        Symbol& s = symbols_[id];
+        std::lock_guard<std::mutex> lock(s.book->mutex());
+        if (s.dirty) publish(id, deltas_, changes_);   // else already published above
+    }
+
+    return finishTick();
 }
 
+void MarketDataGenerator::tickShards() {
+    for (ShardTick& t : shard_ticks_) t.due.clear();
+    for (SymbolId id : due_now_) shard_ticks_[symbols_[id].shard].due.push_back(id);
+    // the shards publish for us: we hold snapshot_mutex_ until they are done
+    shards_->runOnAll([this](std::size_t k) {
+        ShardTick& t = shard_ticks_[k];
+        t.deltas.clear();
+        t.changes.clear();
+        for (SymbolId id : t.due) {
+            Symbol& s = symbols_[id];
+            s.book->rebuildAround(s.reports);
+            if (order_log_ && !s.reports.empty()) order_log_->append(id, s.reports);
+            s.book->setNextTickTime(now_ms_);
+            publish(id, t.deltas, t.changes);
+        }
+        for (SymbolId id : t.dirty) {
+            if (symbols_[id].dirty) publish(id, t.deltas, t.changes);
+        }
+        t.dirty.clear();
+    });
 
-void MarketDataGenerator::checkTick(int64_t now_ms, OrderBook& book) {
-    auto next_tick_ms_ = book.getNextTickTime();
-    if (next_tick_ms_ == 0) {
-        book.setNextTickTime(now_ms);
+    for (SymbolId id : due_now_) {
+        Symbol& s = symbols_[id];
+        // only rebuilds write the tick time, and they run inside runOnAll()
+        due_.emplace(s.book->getNextTickTime(), id);
+        if (!s.reports.empty()) {
+            if (execution_sink_) execution_sink_(s.name, s.reports);
+            s.reports.clear();
+        }
     }
-    if (now_ms >= next_tick_ms_) {
-        book.rebuildAround();
-        book.setNextTickTime(now_ms);
+    for (const ShardTick& t : shard_ticks_) {
+        const std::size_t offset = changes_.size();
+        changes_.insert(changes_.end(), t.changes.begin(), t.changes.end());
+        for (const Delta& d : t.deltas) deltas_.push_back({d.id, d.seq, d.first + offset, d.count});
     }
 }
 
+MarketDataGenerator::Frame MarketDataGenerator::replayMarketData(const JournalTick& tick) {
+    std::lock_guard<std::mutex> guard(snapshot_mutex_);
+    now_ms_ = tick.time_ms;
+    seq_ = tick.tick;
+    deltas_.clear();
+    changes_.clear();
+    for (const JournalTick::Delta& d : tick.deltas) {
+        Symbol& s = symbols_[d.symbol];
+        for (std::size_t i = d.first; i < d.first + d.count; ++i) {
+            const LevelChange& c = tick.changes[i];
+            if (c.side == Side::Buy) {
+                s.bid_count = static_cast<std::uint8_t>(applyLevelChange(c.side, s.bids, s.bid_count, kTopLevels, c));
+            } else {
+                s.ask_count = static_cast<std::uint8_t>(applyLevelChange(c.side, s.asks, s.ask_count, kTopLevels, c));
+            }
+        }
+        deltas_.push_back({d.symbol, d.seq, changes_.size(), d.count});
+        changes_.insert(changes_.end(), tick.changes.begin() + d.first, tick.changes.begin() + d.first + d.count);
+        s.seq = d.seq;
+        s.fragment_stale = true;
+        s.snapshot_json.reset();
+        s.snapshot_binary.reset();
+    }
+    return finishTick();
+}
 
-std::string MarketDataGenerator::makeMarketData() {
-    now_ms_ = getCurrentTimeInMilliseconds();
-    json j;
-    j["action"] = "market_data";
-    j["event"] = "market_data";
-    // 修改：遍历时使用非 const 引用，并将 now_ms 传入 checkTick
-    for (auto& [symbol, ob] : order_books) {
-        checkTick(now_ms_, ob);
-        j["data"][symbol] = ob.getTop5OfBook();
+MarketDataGenerator::Frame MarketDataGenerator::finishTick() {
+    if (!deltas_.empty()) {
+        snapshot_json_.reset();
+        snapshot_binary_.reset();
     }
-    j["timestamp"] = now_ms_; // 使用外部传入的时间戳
-    return j.dump();
+    snapshot_tick_ = seq_ % kSnapshotEvery == 1;   // the first tick is a snapshot too
+    if (journal_ && (snapshot_tick_ || !deltas_.empty())) writeJournal();
+    if (snapshot_tick_) return buildSnapshot(false);
+    if (deltas_.empty()) return nullptr;
+
+    return buildDeltaFrame(deltas_.data(), deltas_.size());
 }
 
+void MarketDataGenerator::writeJournal() {
+    if (!journal_->beginTick(now_ms_, seq_, deltas_.size(), changes_.size())) {
+        std::fprintf(stderr, "market data journal stopped\n");
+        journal_.reset();
+        return;
+    }
+    for (const Delta& d : deltas_) journal_->addDelta(d.id, d.seq, changes_.data() + d.first, d.count);
+    journal_->commitTick();
+}
+
+MarketDataGenerator::Frame MarketDataGenerator::buildDeltaFrame(const Delta* deltas, std::size_t n) const {
+    std::size_t changes = 0;
+    for (std::size_t i = 0; i < n; ++i) changes += deltas[i].count;
+    std::string out;
+    out.reserve(96 + n * 48 + changes * 64);
+    JsonWriter w(out);
+    w.beginObject();
+    w.key("action").value("market_data_delta");
+    w.key("data").beginArray();
+    for (std::size_t i = 0; i < n; ++i) writeDelta(w, deltas[i]);
+    w.endArray();
+    w.key("event").value("market_data_delta");
+    w.key("timestamp").value(now_ms_);
+    w.endObject();
+    return std::make_shared<const std::string>(std::move(out));
+}
+
+void MarketDataGenerator::writeDelta(JsonWriter& w, const Delta& d) const {
+    w.beginObject();
+    w.key("changes").beginArray();
+    for (std::size_t i = d.first; i < d.first + d.count; ++i) {
+        const LevelChange& c = changes_[i];
+        w.beginObject()
+            .key("price").value(c.price)
+            .key("side").value(toString(c.side))
+            .key("type").value(toString(c.action))
+            .key("volume").value(c.volume)
+            .endObject();
+    }
+    w.endArray();
+    w.key("seq").value(d.seq);
+    w.key("symbol").value(symbols_[d.id].name);
+    w.endObject();
+}
+
+void MarketDataGenerator::appendDelta(std::string& out, const Delta& d) const {
+    wire::DeltaHeader dh{};
+    wire::copyFixed(dh.symbol, sizeof(dh.symbol), symbols_[d.id].name);
+    dh.seq = d.seq;
+    dh.change_count = static_cast<std::uint16_t>(d.count);
+    wire::appendPod(out, dh);
+    for (std::size_t i = d.first; i < d.first + d.count; ++i) {
+        const LevelChange& c = changes_[i];
+        wire::appendPod(out, wire::LevelChange{static_cast<std::uint8_t>(c.side),
+                                               static_cast<std::uint8_t>(c.action), c.price, c.volume});
+    }
+}
+
+void MarketDataGenerator::appendBook(std::string& out, const Symbol& s) const {
+    wire::BookHeader bh{};
+    wire::copyFixed(bh.symbol, sizeof(bh.symbol), s.name);
+    bh.seq = s.seq;
+    bh.bid_count = s.bid_count;
+    bh.ask_count = s.ask_count;
+    wire::appendPod(out, bh);
+    for (size_t i = 0; i < s.bid_count; ++i) wire::appendPod(out, wire::Level{s.bids[i].price, s.bids[i].volume});
+    for (size_t i = 0; i < s.ask_count; ++i) wire::appendPod(out, wire::Level{s.asks[i].price, s.asks[i].volume});
+}
+
+
+MarketDataGenerator::Frame MarketDataGenerator::makeMarketDataBinary() {
+    std::lock_guard<std::mutex> guard(snapshot_mutex_);
+    if (snapshot_tick_) return buildSnapshot(true);
+    if (deltas_.empty()) return nullptr;
+
+    std::string out;
+    out.reserve(sizeof(wire::FrameHeader) + sizeof(wire::MarketDataHeader) +
+                deltas_.size() * sizeof(wire::DeltaHeader) + changes_.size() * sizeof(wire::LevelChange));
+    size_t at = wire::beginFrame(out, wire::kMarketDataDelta, seq_);
+    wire::appendPod(out, wire::MarketDataHeader{now_ms_, static_cast<std::uint16_t>(deltas_.size())});
+    for (const Delta& d : deltas_) appendDelta(out, d);
+    wire::endFrame(out, at);
+    return std::make_shared<const std::string>(std::move(out));
+}
+
+
+MarketDataGenerator::Frame MarketDataGenerator::snapshot(bool binary) {
+    std::lock_guard<std::mutex> guard(snapshot_mutex_);
+    return buildSnapshot(binary);
+}
+
+const MarketDataGenerator::Frame& MarketDataGenerator::buildSnapshot(bool binary) {
+    if (binary) {
+        if (snapshot_binary_) return snapshot_binary_;
+        std::string out;
+        out.reserve(sizeof(wire::FrameHeader) + sizeof(wire::MarketDataHeader) +
+                    symbols_.size() * (sizeof(wire::BookHeader) + 2 * kTopLevels * sizeof(wire::Level)));
+        size_t at = wire::beginFrame(out, wire::kMarketData, seq_);
+        wire::appendPod(out, wire::MarketDataHeader{now_ms_, static_cast<std::uint16_t>(symbols_.size())});
+        for (SymbolId id : sorted_) appendBook(out, symbols_[id]);
+        wire::endFrame(out, at);
+        snapshot_binary_ = std::make_shared<const std::string>(std::move(out));
+        return snapshot_binary_;
+    }
+
+    if (snapshot_json_) return snapshot_json_;
+    // splice the cached per-book fragments; same bytes as dumping the
+    // whole object (keys sorted: action, data, event, timestamp)
+    std::size_t bytes = 96;
+    for (auto& s : symbols_) {
+        if (s.fragment_stale) renderFragment(s);
+        bytes += s.key.size() + s.fragment.size() + 2;
+    }
+    std::string out;
+    out.reserve(bytes);
+    out += R"({"action":"market_data","data":{)";
+    for (std::size_t i = 0; i < sorted_.size(); ++i) {
+        const Symbol& s = symbols_[sorted_[i]];
+        if (i > 0) out += ',';
+        out += s.key;
+        out += ':';
+        out += s.fragment;
+    }
+    out += R"(},"event":"market_data","timestamp":)";
+    out += std::to_string(now_ms_);
+    out += '}';
+    snapshot_json_ = std::make_shared<const std::string>(std::move(out));
+    return snapshot_json_;
+}
+
+
+MarketDataGenerator::Frame MarketDataGenerator::symbolSnapshot(SymbolId id, bool binary) {
+    std::lock_guard<std::mutex> guard(snapshot_mutex_);
+    return buildSymbolSnapshot(id, binary);
+}
+
+const MarketDataGenerator::Frame& MarketDataGenerator::buildSymbolSnapshot(SymbolId id, bool binary) {
+    Symbol& s = symbols_[id];
+    if (binary) {
+        if (!s.snapshot_binary) {
+            std::string out;
+            size_t at = wire::beginFrame(out, wire::kMarketData, seq_);
+            wire::appendPod(out, wire::MarketDataHeader{now_ms_, 1});
+            appendBook(out, s);
+            wire::endFrame(out, at);
+            s.snapshot_binary = std::make_shared<const std::string>(std::move(out));
+        }
+        return s.snapshot_binary;
+    }
+    if (!s.snapshot_json) {
+        if (s.fragment_stale) renderFragment(s);
+        std::string out;
+        out.reserve(96 + s.key.size() + s.fragment.size());
+        out += R"({"action":"market_data","data":{)";
+        out += s.key;
+        out += ':';
+        out += s.fragment;
+        out += R"(},"event":"market_data","timestamp":)";
+        out += std::to_string(now_ms_);
+        out += '}';
+        s.snapshot_json = std::make_shared<const std::string>(std::move(out));
+    }
+    return s.snapshot_json;
+}
+
+void MarketDataGenerator::makeSymbolFrames(bool want_json, bool want_binary, std::vector<SymbolFrame>& out) {
+    std::lock_guard<std::mutex> guard(snapshot_mutex_);
+    if (snapshot_tick_) {
+        out.reserve(out.size() + symbols_.size());
+        for (SymbolId id = 0; id < symbols_.size(); ++id) {
+            SymbolFrame f{id, nullptr, nullptr};
+            if (want_json) f.json = buildSymbolSnapshot(id, false);
+            if (want_binary) f.binary = buildSymbolSnapshot(id, true);
+            out.push_back(std::move(f));
+        }
+        return;
+    }
+    out.reserve(out.size() + deltas_.size());
+    for (const Delta& d : deltas_) {
+        SymbolFrame f{d.id, nullptr, nullptr};
+        if (want_json) f.json = buildDeltaFrame(&d, 1);
+        if (want_binary) {
+            std::string bin;
+            size_t at = wire::beginFrame(bin, wire::kMarketDataDelta, seq_);
+            wire::appendPod(bin, wire::MarketDataHeader{now_ms_, 1});
+            appendDelta(bin, d);
+            wire::endFrame(bin, at);
+            f.binary = std::make_shared<const std::string>(std::move(bin));
+        }
+        out.push_back(std::move(f));
+    }
+}
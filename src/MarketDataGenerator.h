@@ -1,18 +1,218 @@
 #pragma once
 
-#include <map>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "JsonWriter.h"
+#include "MarketDataJournal.h"
 #include "OrderBook.h"
 
 using nlohmann::json;
 
+class EngineShards; // forward declaration (defined in EngineShards.h)
+class OrderLog;     // forward declaration (defined in OrderLog.h)
+class WorkerPool;   // forward declaration (defined in WorkerPool.h)
+
+// Interned symbol: index into MarketDataGenerator's dense symbol table.
+using SymbolId = std::uint32_t;
+constexpr SymbolId kNoSymbol = static_cast<SymbolId>(-1);
+
+/*
+ Market data is published incrementally. Each timer tick yields either
+ a delta frame ("market_data_delta") with the level add/update/delete
+ changes of the books that changed since the previous tick, or, every
+ kSnapshotEvery ticks, a full snapshot ("market_data"). Nothing is sent
+ for a tick where no book changed.
+
+ Every symbol has its own sequence number, bumped once per delta. A
+ snapshot carries the sequence each book is current to; a client applies
+ deltas with seq == last + 1, drops older ones, and on a gap asks for a
+ snapshot ("snapshot" request) or waits for the periodic one.
+*/
 class MarketDataGenerator {
-    std::map<std::string, OrderBook> order_books;
-    std::int64_t now_ms_;
 public:
-    MarketDataGenerator();
-    void checkTick(int64_t now_ms, OrderBook& book);
-    std::string makeMarketData();
-};
+    static constexpr std::size_t kMaxSymbols = 65535;  // wire::MarketDataHeader::symbol_count
+    static constexpr int kTopLevels = 5;
+    static constexpr std::uint64_t kSnapshotEvery = 20;  // ticks (5 s at 250 ms)
+    // Rebuild batches this large go to the worker pool, kRebuildGrain books per task.
+    static constexpr std::size_t kParallelRebuildMin = 256;
+    static constexpr std::size_t kRebuildGrain = 64;
+
+    using Frame = std::shared_ptr<const std::string>;
+
+private:
+    struct Symbol {
+        std::string name;
+        std::string key;                    // name as a JSON string, e.g. "\"A\""
+        std::unique_ptr<OrderBook> book;
+        std::uint32_t shard = 0;            // owning engine shard, when sharded
+        bool dirty = false;                 // guarded by book->mutex(), or owned by the shard
+        // Last published top of book; guarded by snapshot_mutex_.
+        std::uint64_t seq = 0;
+        PriceLevel bids[kTopLevels];
+        PriceLevel asks[kTopLevels];
+        std::uint8_t bid_count = 0;
+        std::uint8_t ask_count = 0;
+        std::string fragment;               // {"buy":[...],"sell":[...],"seq":N}
+        bool fragment_stale = true;
+        Frame snapshot_json;                // this book alone, cached until it changes
+        Frame snapshot_binary;
+        std::vector<ExecutionReport> reports;   // of the last rebuild; timer thread only
+    };
+
+    // Changes of one symbol within the current tick: changes_[first, first + count).
+    struct Delta {
+        SymbolId id;
+        std::uint64_t seq;
+        std::size_t first;
+        std::size_t count;
+    };
+
+    struct NameHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+
+    using Due = std::pair<std::int64_t, SymbolId>;   // next tick time, symbol
+
+    std::vector<Symbol> symbols_;
+    std::unordered_map<std::string, SymbolId, NameHash, std::equal_to<>> ids_;
+    std::vector<SymbolId> sorted_;          // ids by name, the snapshot order
+    // Books by next tick time; timer thread only.
+    std::priority_queue<Due, std::vector<Due>, std::greater<>> due_;
+    std::vector<SymbolId> due_now_;         // rebuilt this tick
+    WorkerPool* pool_ = nullptr;            // spreads large rebuild batches
+    std::uint64_t seed_ = 0;                // 0: every book draws a random stream
+    std::function<std::int64_t()> clock_{}; // tick time in ms; wall clock when unset
+    std::unique_ptr<JournalWriter> journal_;   // records every tick; timer thread only
+    OrderLog* order_log_ = nullptr;         // re-quote reports, logged under the book lock
+
+    std::mutex dirty_mutex_;
+    std::vector<SymbolId> dirty_;           // books changed by order entry since the last tick
+
+    // Sharded: a tick's work and output per shard. due is filled by the
+    // timer thread before the shards run; the rest is the shard's own.
+    struct alignas(64) ShardTick {
+        std::vector<SymbolId> due;
+        std::vector<SymbolId> dirty;        // takes the place of dirty_
+        std::vector<Delta> deltas;          // first indexes changes
+        std::vector<LevelChange> changes;
+    };
+    EngineShards* shards_ = nullptr;
+    std::vector<ShardTick> shard_ticks_;
+
+    // Guards the published state below and in Symbol; snapshot() is called
+    // from worker threads.
+    std::mutex snapshot_mutex_;
+    std::int64_t now_ms_{0};
+    std::uint64_t seq_{0};                  // tick counter, used as binary frame seq
+    bool snapshot_tick_{false};
+    std::vector<Delta> deltas_;             // this tick
+    std::vector<LevelChange> changes_;      // this tick
+    Frame snapshot_json_;                   // cached until the next change
+    Frame snapshot_binary_;
+
+    // Receives reports for session orders that traded against re-quoted liquidity.
+    std::function<void(const std::string&, const std::vector<ExecutionReport>&)> execution_sink_{};
+
+    // Diff the book's top levels against the published ones and record a
+    // delta if they moved into deltas / changes. Caller holds the book lock
+    // (or is its shard) and snapshot_mutex_ (or runs for its holder).
+    void publish(SymbolId id, std::vector<Delta>& deltas, std::vector<LevelChange>& changes);
+    // makeMarketData() step 1 and 2 on the engine shards: each rebuilds and
+    // publishes its own books, and the outputs are merged in shard order.
+    void tickShards();
+    // Common end of makeMarketData() / replayMarketData(): journal the
+    // tick and build its frame. Caller holds snapshot_mutex_.
+    Frame finishTick();
+    void writeJournal();
+    // JSON is written directly with JsonWriter, keys in json::dump() order.
+    static void renderFragment(Symbol& s);
+    void writeDelta(JsonWriter& w, const Delta& d) const;
+    Frame buildDeltaFrame(const Delta* deltas, std::size_t n) const;
+    void appendDelta(std::string& out, const Delta& d) const;
+    void appendBook(std::string& out, const Symbol& s) const;
+    // Caller holds snapshot_mutex_.
+    const Frame& buildSnapshot(bool binary);
+    const Frame& buildSymbolSnapshot(SymbolId id, bool binary);
 
+public:
+    // Universe of `symbols` books: "A" plus S00001, S00002, ...
+    // A non-zero seed makes the run reproducible: every book's random
+    // stream is keyed by the seed and its symbol id.
+    explicit MarketDataGenerator(std::size_t symbols = 1, std::uint64_t seed = 0);
+
+    // Add a book before the server starts; kNoSymbol if the name is taken
+    // or the universe is full. The symbol table is fixed once serving, so
+    // lookups need no lock; each book has its own.
+    SymbolId addSymbol(const std::string& name, int fair_price, int max_volume);
+
+    SymbolId findSymbol(std::string_view name) const;
+    const std::string& symbolName(SymbolId id) const { return symbols_[id].name; }
+    OrderBook& book(SymbolId id) { return *symbols_[id].book; }
+    std::size_t symbolCount() const { return symbols_.size(); }
+
+    // Order entry changed the book; caller holds book(id).mutex(), or is
+    // its shard.
+    void markDirty(SymbolId id);
+
+    // Hand the books to engine shards, by a hash of the symbol name: from
+    // now on only the owning shard's thread touches a book, and ticks
+    // rebuild and publish on the shards. Call before serving.
+    void setShards(EngineShards* shards);
+    EngineShards* shards() const { return shards_; }
+    std::size_t shardOf(SymbolId id) const { return symbols_[id].shard; }
+
+    // Rebuild due books on these workers (and the timer thread). Call before serving.
+    void setWorkerPool(WorkerPool* pool) { pool_ = pool; }
+
+    // Time source for ticks (ms since the epoch), e.g. a simulated clock.
+    // Call before serving; makeMarketData() calls it on the timer thread.
+    void setClock(std::function<std::int64_t()> now_ms) { clock_ = std::move(now_ms); }
+
+    // Record every tick from now on (see MarketDataJournal.h). Call before serving.
+    void setJournal(std::unique_ptr<JournalWriter> journal) { journal_ = std::move(journal); }
+
+    // Log the reports of session orders hit by re-quoting (see
+    // MatchingEngine::setOrderLog). Call before serving.
+    void setOrderLog(OrderLog* log) { order_log_ = log; }
+
+    void setExecutionSink(std::function<void(const std::string&, const std::vector<ExecutionReport>&)> cb) {
+        execution_sink_ = std::move(cb);
+    }
+
+    // Timer thread: rebuild the books that are due, publish the changes of
+    // those and of the dirty ones, and return this tick's JSON frame (delta
+    // or periodic snapshot); null when there is nothing to send.
+    Frame makeMarketData();
+    // Replay instead of generating: publish a recorded tick (its timestamp,
+    // tick number and level changes) and return its frame like
+    // makeMarketData(). The books are not touched, so order entry still
+    // matches against them but no longer shows in market data.
+    Frame replayMarketData(const JournalTick& tick);
+    // The same frame in the binary encoding (no books are touched).
+    Frame makeMarketDataBinary();
+
+    // Any thread: full snapshot of the published state, shared and rebuilt
+    // at most once per change.
+    Frame snapshot(bool binary);
+    // Any thread: the same for one book.
+    Frame symbolSnapshot(SymbolId id, bool binary);
+
+    // This tick's update split into one frame per symbol, for clients that
+    // subscribe to a subset. Timer thread, after makeMarketData().
+    struct SymbolFrame {
+        SymbolId id;
+        Frame json;
+        Frame binary;
+    };
+    void makeSymbolFrames(bool want_json, bool want_binary, std::vector<SymbolFrame>& out);
+};
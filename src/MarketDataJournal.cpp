@@ -0,0 +1,217 @@
+#include "MarketDataJournal.h"
+#include "BinaryProtocol.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+JournalWriter::~JournalWriter() {
+    close();
+}
+
+bool JournalWriter::open(const std::string& path, const std::vector<std::string>& symbols) {
+    close();
+    // ids, name lengths and per-tick delta counts are u16 on disk
+    if (symbols.size() > UINT16_MAX) {
+        std::fprintf(stderr, "%s: %zu symbols, a journal holds at most %u\n", path.c_str(), symbols.size(),
+                     static_cast<unsigned>(UINT16_MAX));
+        return false;
+    }
+    for (const auto& name : symbols) {
+        if (name.size() > UINT16_MAX) {
+            std::fprintf(stderr, "%s: symbol name of %zu bytes is too long\n", path.c_str(), name.size());
+            return false;
+        }
+    }
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        std::perror(path.c_str());
+        return false;
+    }
+    std::size_t table = 0;
+    for (const auto& name : symbols) table += sizeof(std::uint16_t) + name.size();
+    if (!reserve(sizeof(journal::FileHeader) + table)) return false;
+
+    journal::FileHeader h{};
+    std::memcpy(h.magic, journal::kMagic, sizeof(h.magic));
+    h.version = journal::kVersion;
+    h.symbol_count = static_cast<std::uint32_t>(symbols.size());
+    put(&h, sizeof(h));
+    for (const auto& name : symbols) {
+        const auto len = static_cast<std::uint16_t>(name.size());
+        put(&len, sizeof(len));
+        put(name.data(), len);
+    }
+    commitTick();
+    return true;
+}
+
+// Grow the file and the mapping so n more bytes fit at the cursor.
+bool JournalWriter::reserve(std::size_t n) {
+    if (pos_ + n <= capacity_) return true;
+    std::size_t cap = capacity_ ? capacity_ * 2 : kPreallocate;
+    while (cap < pos_ + n) cap *= 2;
+    // allocate the blocks now so stores into the mapping cannot SIGBUS on
+    // a full disk; ftruncate where the filesystem cannot
+    int err = posix_fallocate(fd_, 0, static_cast<off_t>(cap));
+    if (err == EOPNOTSUPP || err == EINVAL) err = ftruncate(fd_, static_cast<off_t>(cap)) < 0 ? errno : 0;
+    if (err != 0) {
+        errno = err;
+        std::perror("journal: allocate");
+        close();
+        return false;
+    }
+    void* p = base_ ? mremap(base_, capacity_, cap, MREMAP_MAYMOVE)
+                    : mmap(nullptr, cap, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED) {
+        std::perror("journal: mmap");
+        close();
+        return false;
+    }
+    base_ = static_cast<char*>(p);
+    capacity_ = cap;
+    return true;
+}
+
+void JournalWriter::put(const void* data, std::size_t n) {
+    std::memcpy(base_ + pos_, data, n);
+    pos_ += n;
+}
+
+bool JournalWriter::beginTick(std::int64_t time_ms, std::uint64_t tick, std::size_t deltas, std::size_t changes) {
+    if (fd_ < 0) return false;
+    if (deltas > UINT16_MAX) {
+        std::fprintf(stderr, "journal: tick of %zu deltas does not fit\n", deltas);
+        close();
+        return false;
+    }
+    if (!reserve(sizeof(journal::TickHeader) + deltas * sizeof(journal::DeltaHeader) +
+                 changes * sizeof(wire::LevelChange))) {
+        return false;
+    }
+    journal::TickHeader th{time_ms, tick, static_cast<std::uint16_t>(deltas)};   // checked above
+    put(&th, sizeof(th));
+    return true;
+}
+
+void JournalWriter::addDelta(std::uint32_t symbol, std::uint64_t seq, const LevelChange* changes, std::size_t count) {
+    // open() capped the symbol ids; a delta changes a few top levels only
+    assert(symbol <= UINT16_MAX && count <= UINT16_MAX);
+    journal::DeltaHeader dh{static_cast<std::uint16_t>(symbol), seq, static_cast<std::uint16_t>(count)};
+    put(&dh, sizeof(dh));
+    for (std::size_t i = 0; i < count; ++i) {
+        const LevelChange& c = changes[i];
+        wire::LevelChange wc{static_cast<std::uint8_t>(c.side), static_cast<std::uint8_t>(c.action), c.price, c.volume};
+        put(&wc, sizeof(wc));
+    }
+}
+
+void JournalWriter::commitTick() {
+    end_ = pos_;
+    const std::uint64_t end = end_;
+    std::memcpy(base_ + offsetof(journal::FileHeader, end), &end, sizeof(end));
+}
+
+void JournalWriter::close() {
+    if (base_) munmap(base_, capacity_);
+    if (fd_ >= 0) {
+        if (ftruncate(fd_, static_cast<off_t>(end_)) < 0) std::perror("journal: truncate");
+        ::close(fd_);
+    }
+    fd_ = -1;
+    base_ = nullptr;
+    capacity_ = pos_ = 0;
+}
+
+
+JournalReader::~JournalReader() {
+    if (base_) munmap(const_cast<char*>(base_), size_);
+}
+
+template <typename T>
+bool JournalReader::get(T& v) {
+    if (end_ - pos_ < sizeof(T)) return false;
+    std::memcpy(&v, base_ + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+}
+
+bool JournalReader::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::perror(path.c_str());
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) < 0 || static_cast<std::size_t>(st.st_size) < sizeof(journal::FileHeader)) {
+        std::fprintf(stderr, "%s: not a market data journal\n", path.c_str());
+        ::close(fd);
+        return false;
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        std::perror("journal: mmap");
+        return false;
+    }
+    base_ = static_cast<const char*>(p);
+    madvise(p, size_, MADV_SEQUENTIAL);
+
+    journal::FileHeader h;
+    end_ = size_;
+    if (!get(h) || std::memcmp(h.magic, journal::kMagic, sizeof(h.magic)) != 0 || h.version != journal::kVersion) {
+        std::fprintf(stderr, "%s: not a market data journal (or another version)\n", path.c_str());
+        return false;
+    }
+    end_ = std::min<std::size_t>(h.end, size_);
+    symbols_.clear();
+    symbols_.reserve(h.symbol_count);
+    for (std::uint32_t i = 0; i < h.symbol_count; ++i) {
+        std::uint16_t len;
+        if (!get(len) || end_ - pos_ < len) {
+            std::fprintf(stderr, "%s: truncated symbol table\n", path.c_str());
+            return false;
+        }
+        symbols_.emplace_back(base_ + pos_, len);
+        pos_ += len;
+    }
+    return true;
+}
+
+bool JournalReader::next() {
+    if (pos_ == end_) return false;
+    tick_.deltas.clear();
+    tick_.changes.clear();
+    journal::TickHeader th;
+    bool ok = get(th);
+    for (std::uint16_t d = 0; ok && d < th.delta_count; ++d) {
+        journal::DeltaHeader dh;
+        ok = get(dh) && dh.symbol < symbols_.size();
+        if (!ok) break;
+        tick_.deltas.push_back({dh.symbol, dh.seq, tick_.changes.size(), dh.change_count});
+        for (std::uint16_t k = 0; ok && k < dh.change_count; ++k) {
+            wire::LevelChange wc;
+            ok = get(wc) && wc.side <= 1 && wc.action <= 2;
+            if (ok) {
+                tick_.changes.push_back({static_cast<Side>(wc.side), static_cast<LevelAction>(wc.action),
+                                         wc.price, wc.volume});
+            }
+        }
+    }
+    if (!ok) {
+        std::fprintf(stderr, "journal: malformed record at offset %zu\n", pos_);
+        pos_ = end_;
+        return false;
+    }
+    tick_.time_ms = th.time_ms;
+    tick_.tick = th.tick;
+    return true;
+}
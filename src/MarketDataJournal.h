@@ -0,0 +1,143 @@
+// MarketDataJournal.h
+// Compact binary journal of published market data, for reproducing a
+// session: MarketDataGenerator appends every tick's book updates through a
+// JournalWriter, and replay feeds them back through a JournalReader in
+// place of the random generator.
+//
+// The file is written and read through mmap. The writer preallocates it in
+// large steps, so a tick costs a memcpy into the mapping and no syscall;
+// the file is truncated to its contents on close. Layout (packed,
+// little-endian):
+//
+//   FileHeader
+//   symbol_count times { u16 length, name }    ids are table positions
+//   ticks: TickHeader, then delta_count times
+//          { DeltaHeader, change_count wire::LevelChange }
+//
+// A tick is recorded when it published a change or was a snapshot tick.
+// FileHeader::end is bumped after each complete tick, so the journal of a
+// server that died is readable up to its last tick.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "OrderBook.h"
+
+namespace journal {
+
+constexpr char kMagic[8] = {'T', 'S', 'M', 'D', 'J', 'R', 'N', 'L'};
+constexpr std::uint32_t kVersion = 1;
+
+#pragma pack(push, 1)
+struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t symbol_count;
+    std::uint64_t end;          // bytes of complete records, from the file start
+};
+
+struct TickHeader {
+    std::int64_t time_ms;       // the tick's market data timestamp
+    std::uint64_t tick;         // generator tick counter (binary frame seq)
+    std::uint16_t delta_count;
+};
+
+struct DeltaHeader {
+    std::uint16_t symbol;       // index into the symbol table
+    std::uint64_t seq;          // per-symbol sequence
+    std::uint16_t change_count;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FileHeader) == 24);
+static_assert(sizeof(TickHeader) == 18);
+static_assert(sizeof(DeltaHeader) == 12);
+
+} // namespace journal
+
+// One recorded tick; a delta's changes are changes[first, first + count).
+struct JournalTick {
+    struct Delta {
+        std::uint32_t symbol;
+        std::uint64_t seq;
+        std::size_t first;
+        std::size_t count;
+    };
+
+    std::int64_t time_ms = 0;
+    std::uint64_t tick = 0;
+    std::vector<Delta> deltas;
+    std::vector<LevelChange> changes;
+};
+
+class JournalWriter {
+public:
+    static constexpr std::size_t kPreallocate = 64 * 1024 * 1024;  // first step; doubles after
+
+    JournalWriter() = default;
+    ~JournalWriter();
+
+    JournalWriter(const JournalWriter&) = delete;
+    JournalWriter& operator=(const JournalWriter&) = delete;
+
+    // Create (or truncate) the file and write the symbol table.
+    // Return false on error (reported with perror), or for more than
+    // 65535 symbols, which the u16 ids cannot address.
+    bool open(const std::string& path, const std::vector<std::string>& symbols);
+
+    // One writer thread. Start a tick of `deltas` deltas and `changes`
+    // changes in total, add exactly that many, then commit. False if the
+    // file could not grow; the journal is closed then.
+    bool beginTick(std::int64_t time_ms, std::uint64_t tick, std::size_t deltas, std::size_t changes);
+    void addDelta(std::uint32_t symbol, std::uint64_t seq, const LevelChange* changes, std::size_t count);
+    void commitTick();
+
+    // Truncate the file to its records and unmap it.
+    void close();
+
+    std::uint64_t bytes() const { return end_; }
+
+private:
+    bool reserve(std::size_t n);
+    void put(const void* data, std::size_t n);
+
+    int fd_ = -1;
+    char* base_ = nullptr;
+    std::size_t capacity_ = 0;   // mapped (and allocated) bytes
+    std::size_t pos_ = 0;        // write cursor
+    std::size_t end_ = 0;        // committed bytes
+};
+
+class JournalReader {
+public:
+    JournalReader() = default;
+    ~JournalReader();
+
+    JournalReader(const JournalReader&) = delete;
+    JournalReader& operator=(const JournalReader&) = delete;
+
+    // Map the file and read the symbol table. Return false on error.
+    bool open(const std::string& path);
+
+    const std::vector<std::string>& symbols() const { return symbols_; }
+
+    // Decode the next tick into tick(); false at the end of the journal
+    // (or at a malformed record, which is reported).
+    bool next();
+    const JournalTick& tick() const { return tick_; }
+
+private:
+    template <typename T>
+    bool get(T& v);
+
+    const char* base_ = nullptr;
+    std::size_t size_ = 0;       // mapped bytes
+    std::size_t end_ = 0;        // committed bytes
+    std::size_t pos_ = 0;
+    std::vector<std::string> symbols_;
+    JournalTick tick_;
+};
@@ -0,0 +1,169 @@
+#include "MatchingEngine.h"
+
+#include "Client.h"
+#include "MarketDataGenerator.h"
+#include "OrderLog.h"
+
+#include <algorithm>
+
+MatchingEngine::MatchingEngine(MarketDataGenerator& mdg) : mdg_(mdg) {
+    mdg_.setExecutionSink([this](const std::string& symbol, const std::vector<ExecutionReport>& reports) {
+        deliver(symbol, reports);
+    });
+}
+
+MatchingEngine::~MatchingEngine() {
+    mdg_.setExecutionSink(nullptr);
+    mdg_.setOrderLog(nullptr);
+}
+
+void MatchingEngine::setOrderLog(OrderLog* log) {
+    log_ = log;
+    mdg_.setOrderLog(log);
+}
+
+void MatchingEngine::recover(const OrderLogRecovery& recovered) {
+    next_order_id_.store(std::max(next_order_id_.load(), recovered.next_order_id));
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex_);
+        next_session_id_ = std::max(next_session_id_, recovered.next_session);
+    }
+    std::vector<ExecutionReport> reports;
+    for (SymbolId id = 0; id < recovered.books.size() && id < mdg_.symbolCount(); ++id) {
+        if (recovered.books[id].empty()) continue;
+        OrderBook& book = mdg_.book(id);
+        auto lock = lockBook(book);
+        reports.clear();
+        book.restore(recovered.books[id], reports);
+        // no session is connected yet; what re-quoting did is only logged
+        if (log_) log_->append(id, reports);
+    }
+}
+
+int MatchingEngine::shardFor(std::string_view symbol) const {
+    if (!mdg_.shards()) return -1;
+    SymbolId sym = mdg_.findSymbol(symbol);
+    return sym == kNoSymbol ? -1 : static_cast<int>(mdg_.shardOf(sym));
+}
+
+EngineShards* MatchingEngine::shards() const {
+    return mdg_.shards();
+}
+
+std::unique_lock<std::mutex> MatchingEngine::lockBook(OrderBook& book) const {
+    if (mdg_.shards()) return std::unique_lock<std::mutex>(book.mutex(), std::defer_lock);
+    return std::unique_lock<std::mutex>(book.mutex());
+}
+
+std::uint32_t MatchingEngine::registerSession(Client* client) {
+    std::lock_guard<std::mutex> lock(sessions_mutex_);
+    std::uint32_t id = next_session_id_++;
+    sessions_.emplace(id, client);
+    return id;
+}
+
+void MatchingEngine::unregisterSession(std::uint32_t session) {
+    std::lock_guard<std::mutex> lock(sessions_mutex_);
+    sessions_.erase(session);
+}
+
+BookResult MatchingEngine::newOrder(std::uint32_t session, const std::string& symbol, Side side, int price,
+                                    int qty, std::vector<ExecutionReport>& own, std::uint64_t& lsn) {
+    lsn = 0;
+    SymbolId sym = mdg_.findSymbol(symbol);
+    if (sym == kNoSymbol) return BookResult::UnknownSymbol;
+    OrderBook* book = &mdg_.book(sym);
+
+    std::uint64_t id = next_order_id_.fetch_add(1, std::memory_order_relaxed);
+    std::vector<ExecutionReport> reports;
+    BookResult res;
+    {
+        auto lock = lockBook(*book);
+        res = book->submit(id, session, side, price, qty, reports);
+        if (res == BookResult::Ok) {
+            mdg_.markDirty(sym);
+            if (log_) lsn = log_->append(sym, reports);
+        }
+    }
+    if (res == BookResult::Ok) route(symbol, id, reports, own, lsn);
+    return res;
+}
+
+BookResult MatchingEngine::cancelOrder(std::uint32_t session, const std::string& symbol, std::uint64_t order_id,
+                                       std::vector<ExecutionReport>& own, std::uint64_t& lsn) {
+    lsn = 0;
+    SymbolId sym = mdg_.findSymbol(symbol);
+    if (sym == kNoSymbol) return BookResult::UnknownSymbol;
+    OrderBook* book = &mdg_.book(sym);
+
+    std::vector<ExecutionReport> reports;
+    BookResult res;
+    {
+        auto lock = lockBook(*book);
+        res = book->cancel(order_id, session, reports);
+        if (res == BookResult::Ok) {
+            mdg_.markDirty(sym);
+            if (log_) lsn = log_->append(sym, reports);
+        }
+    }
+    if (res == BookResult::Ok) route(symbol, order_id, reports, own, lsn);
+    return res;
+}
+
+BookResult MatchingEngine::modifyOrder(std::uint32_t session, const std::string& symbol, std::uint64_t order_id,
+                                       int price, int qty, std::vector<ExecutionReport>& own,
+                                       std::uint64_t& lsn) {
+    lsn = 0;
+    SymbolId sym = mdg_.findSymbol(symbol);
+    if (sym == kNoSymbol) return BookResult::UnknownSymbol;
+    OrderBook* book = &mdg_.book(sym);
+
+    std::vector<ExecutionReport> reports;
+    BookResult res;
+    {
+        auto lock = lockBook(*book);
+        res = book->modify(order_id, session, price, qty, reports);
+        if (res == BookResult::Ok) {
+            mdg_.markDirty(sym);
+            if (log_) lsn = log_->append(sym, reports);
+        }
+    }
+    if (res == BookResult::Ok) route(symbol, order_id, reports, own, lsn);
+    return res;
+}
+
+void MatchingEngine::route(const std::string& symbol, std::uint64_t order_id,
+                           std::vector<ExecutionReport>& reports, std::vector<ExecutionReport>& own,
+                           std::uint64_t lsn) {
+    auto mid = std::stable_partition(reports.begin(), reports.end(),
+                                     [order_id](const ExecutionReport& r) { return r.order_id == order_id; });
+    own.assign(reports.begin(), mid);
+    reports.erase(reports.begin(), mid);
+    if (!reports.empty()) deliverAfter(symbol, std::move(reports), lsn);
+}
+
+void MatchingEngine::deliver(const std::string& symbol, const std::vector<ExecutionReport>& reports) {
+    // re-quote reports were logged by the generator, under the book lock
+    if (log_) deliverAfter(symbol, reports, log_->appended());
+    else send(symbol, reports);
+}
+
+void MatchingEngine::deliverAfter(const std::string& symbol, std::vector<ExecutionReport> reports,
+                                  std::uint64_t lsn) {
+    if (!log_ || lsn == 0) {
+        send(symbol, reports);
+        return;
+    }
+    log_->whenDurable(lsn, [this, symbol, reports = std::move(reports)] { send(symbol, reports); });
+}
+
+void MatchingEngine::send(const std::string& symbol, const std::vector<ExecutionReport>& reports) {
+    std::lock_guard<std::mutex> lock(sessions_mutex_);
+    for (const auto& r : reports) {
+        if (r.owner == 0) continue;
+        auto it = sessions_.find(r.owner);
+        if (it != sessions_.end()) {
+            it->second->sendExecutionReport(symbol, r);
+        }
+    }
+}
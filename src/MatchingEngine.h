@@ -0,0 +1,96 @@
+// MatchingEngine.h
+// Order entry front end. Routes new/cancel/modify requests to the symbol's
+// OrderBook (owned by MarketDataGenerator) and delivers execution reports
+// for resting orders to the session that owns them. With an OrderLog,
+// every event is logged under the book's lock and reports only go out
+// once it is durable.
+//
+// With engine shards (MarketDataGenerator::setShards) a book has no lock:
+// order entry for a symbol must run on its shard, see shardFor().
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "OrderBook.h"
+
+class Client;                // forward declaration (defined in Client.h)
+class EngineShards;          // forward declaration (defined in EngineShards.h)
+class MarketDataGenerator;   // forward declaration (defined in MarketDataGenerator.h)
+class OrderLog;              // forward declaration (defined in OrderLog.h)
+struct OrderLogRecovery;     // forward declaration (defined in OrderLog.h)
+
+class MatchingEngine {
+public:
+    explicit MatchingEngine(MarketDataGenerator& mdg);
+    ~MatchingEngine();
+
+    // Sessions receive unsolicited reports for their resting orders.
+    // Session ids start at 1; 0 is the synthetic liquidity provider.
+    std::uint32_t registerSession(Client* client);
+    void unregisterSession(std::uint32_t session);
+
+    // Order entry. Reports for the request's own order (acknowledgement
+    // first, then its fills) go to `own`; reports for other orders it
+    // touched are delivered to their owners. lsn is the order log
+    // position `own` may be sent at (OrderLog::whenDurable), 0 if nothing
+    // was logged.
+    BookResult newOrder(std::uint32_t session, const std::string& symbol, Side side, int price, int qty,
+                        std::vector<ExecutionReport>& own, std::uint64_t& lsn);
+    BookResult cancelOrder(std::uint32_t session, const std::string& symbol, std::uint64_t order_id,
+                           std::vector<ExecutionReport>& own, std::uint64_t& lsn);
+    BookResult modifyOrder(std::uint32_t session, const std::string& symbol, std::uint64_t order_id,
+                           int price, int qty, std::vector<ExecutionReport>& own, std::uint64_t& lsn);
+
+    // Log every order event from now on, re-quotes included. Call before serving.
+    void setOrderLog(OrderLog* log);
+    OrderLog* orderLog() const { return log_; }
+    // Put the orders replayed from the log back into the books and resume
+    // order and session ids past the logged ones. Call before serving.
+    void recover(const OrderLogRecovery& recovered);
+
+    MarketDataGenerator& marketData() { return mdg_; }
+
+    // The shard order entry for symbol has to run on, -1 when books are
+    // not sharded (any thread will do) or the symbol is unknown.
+    int shardFor(std::string_view symbol) const;
+    EngineShards* shards() const;
+
+    // Sessions subscribed to a subset of the symbols; per-symbol market
+    // data frames are only built while there are any.
+    void countFilteredSession(bool filtered) {
+        if (filtered) filtered_sessions_.fetch_add(1, std::memory_order_relaxed);
+        else filtered_sessions_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    std::size_t filteredSessions() const { return filtered_sessions_.load(std::memory_order_relaxed); }
+
+    // Send each report to its owning session, if still connected, once
+    // everything logged so far is durable.
+    void deliver(const std::string& symbol, const std::vector<ExecutionReport>& reports);
+
+private:
+    // Split the reports of one book operation into the caller's and the
+    // rest, delivered once the log is durable up to lsn.
+    void route(const std::string& symbol, std::uint64_t order_id, std::vector<ExecutionReport>& reports,
+               std::vector<ExecutionReport>& own, std::uint64_t lsn);
+    void deliverAfter(const std::string& symbol, std::vector<ExecutionReport> reports, std::uint64_t lsn);
+    void send(const std::string& symbol, const std::vector<ExecutionReport>& reports);
+    // The book's lock; not taken when the calling shard owns the book.
+    std::unique_lock<std::mutex> lockBook(OrderBook& book) const;
+
+    MarketDataGenerator& mdg_;
+    OrderLog* log_ = nullptr;
+    std::atomic<std::uint64_t> next_order_id_{1};
+
+    std::mutex sessions_mutex_;
+    std::unordered_map<std::uint32_t, Client*> sessions_;
+    std::uint32_t next_session_id_{1};
+    std::atomic<std::size_t> filtered_sessions_{0};
+};
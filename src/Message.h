@@ -1,12 +1,36 @@
 #pragma once
 
 #include <nlohmann/json.hpp>
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+
+#include "BinaryProtocol.h"
 
 using nlohmann::json;
 
+class Client;        // forward declaration (defined in Client.h)
+class Message;
+class MessagePool;   // forward declaration (defined in MessagePool.h)
+
+// Returns a pooled message to its pool; plain delete when pool is null.
+struct MessageDeleter {
+    MessagePool* pool = nullptr;
+    void operator()(Message* msg) const;
+};
+using MessagePtr = std::unique_ptr<Message, MessageDeleter>;
+
 #define MESSAGE_TYPE_LIST \
-    X(Login, "login")
+    X(Login, "login") \
+    X(NewOrder, "new_order") \
+    X(CancelOrder, "cancel_order") \
+    X(ModifyOrder, "modify_order") \
+    X(Snapshot, "snapshot") \
+    X(Subscribe, "subscribe") \
+    X(Unsubscribe, "unsubscribe") \
+    X(Stats, "stats")
 
 enum class MessageType {
 #define X(type, str) type,
@@ -14,13 +38,79 @@ enum class MessageType {
 #undef X
 };
 
+constexpr std::size_t kMessageTypeCount = 0
+#define X(type, str) + 1
+    MESSAGE_TYPE_LIST
+#undef X
+    ;
+
+// FNV-1a, usable at compile time to switch on action strings.
+constexpr std::uint32_t actionHash(std::string_view s) {
+    std::uint32_t h = 2166136261u;
+    for (char c : s) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Every action must hash to a distinct case label.
+static_assert([] {
+    constexpr std::string_view actions[] = {
+#define X(type, str) str,
+        MESSAGE_TYPE_LIST
+#undef X
+    };
+    for (std::size_t i = 0; i < kMessageTypeCount; ++i) {
+        for (std::size_t k = i + 1; k < kMessageTypeCount; ++k) {
+            if (actionHash(actions[i]) == actionHash(actions[k])) return false;
+        }
+    }
+    return true;
+}(), "MESSAGE_TYPE_LIST action hash collision");
+
+// Map a JSON "action" to its type with one hash and one compare,
+// whatever the number of message types.
+constexpr std::optional<MessageType> messageTypeFromAction(std::string_view action) {
+    switch (actionHash(action)) {
+#define X(type, str) \
+    case actionHash(str): \
+        if (action == str) return MessageType::type; \
+        break;
+    MESSAGE_TYPE_LIST
+#undef X
+    }
+    return std::nullopt;
+}
+
 class Message {
     MessageType type_;
-    MessageType getType() const { return type_; }
 public:
     virtual ~Message() = default;
 
-    virtual const json& handle() = 0;
+    // Runs on the client's worker thread; the returned JSON is the response.
+    virtual const json& handle(Client& client) = 0;
+
+    MessageType getType() const { return type_; }
+
+    // Binary sequence number of the request, echoed in the response frame.
+    void setSequence(std::uint64_t seq) { seq_ = seq; }
+
+    // TSC stamps for ServerStats: parsing started / message queued.
+    void setTimestamps(std::uint64_t received, std::uint64_t enqueued) {
+        received_tsc_ = received;
+        enqueued_tsc_ = enqueued;
+    }
+    std::uint64_t receivedAt() const { return received_tsc_; }
+    std::uint64_t enqueuedAt() const { return enqueued_tsc_; }
+
+    // Order log position the response must wait for (OrderLog::whenDurable);
+    // 0 when handle() logged nothing.
+    virtual std::uint64_t durableAt() const { return 0; }
+
+    // Symbol of the book handle() works on, empty if none; with engine
+    // shards the request is handled on that book's shard.
+    virtual std::string_view bookSymbol() const { return {}; }
 
     virtual void toJson() {
         #define X(msg_type, msg_str) \
@@ -31,8 +121,18 @@ public:
         #undef X
         data_["status"] = status_code_;
     }
+
+    // Append the binary response frame to out. Default payload is the status code.
+    virtual void toBinary(std::string& out) const {
+        std::size_t at = wire::beginFrame(out, static_cast<std::uint16_t>(type_), seq_);
+        wire::appendPod(out, wire::StatusResponse{status_code_});
+        wire::endFrame(out, at);
+    }
 protected:
     int status_code_;
+    std::uint64_t seq_ = 0;
+    std::uint64_t received_tsc_ = 0;
+    std::uint64_t enqueued_tsc_ = 0;
     json data_;
     Message(MessageType type_) : type_(type_), status_code_(0) {}
-};
\ No newline at end of file
+};
@@ -1,3 +1,20 @@
 #pragma once
 
-#include "LoginMessage.h"
\ No newline at end of file
+#include "LoginMessage.h"
+#include "NewOrderMessage.h"
+#include "CancelOrderMessage.h"
+#include "ModifyOrderMessage.h"
+#include "SnapshotMessage.h"
+#include "SubscribeMessage.h"
+#include "UnsubscribeMessage.h"
+#include "StatsMessage.h"
+
+#include <algorithm>
+#include <cstddef>
+
+// Slot size of a MessagePool: the largest message type.
+constexpr std::size_t kMaxMessageSize = std::max({
+#define X(msg_type, msg_str) sizeof(msg_type##Message),
+    MESSAGE_TYPE_LIST
+#undef X
+});
@@ -0,0 +1,49 @@
+#include "MessagePool.h"
+
+void MessageDeleter::operator()(Message* msg) const {
+    if (!pool) {
+        delete msg;
+        return;
+    }
+    msg->~Message();
+    pool->deallocate(msg);
+}
+
+// Slabs are arrays of max_align_t, so a slot is a whole number of them
+// (sizeof, not alignof: on x86-64 the two differ).
+MessagePool::MessagePool(std::size_t slot_size)
+    : slot_size_((slot_size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t) *
+                 sizeof(std::max_align_t)) {}
+
+// Every message must be gone (Client waits for its drain before this runs).
+MessagePool::~MessagePool() = default;
+
+void* MessagePool::allocate() {
+    if (!local_) {
+        local_ = returned_.exchange(nullptr, std::memory_order_acquire);
+        if (!local_) grow();
+    }
+    FreeSlot* slot = local_;
+    local_ = slot->next;
+    return slot;
+}
+
+void MessagePool::deallocate(void* p) {
+    auto* slot = static_cast<FreeSlot*>(p);
+    FreeSlot* head = returned_.load(std::memory_order_relaxed);
+    do {
+        slot->next = head;
+    } while (!returned_.compare_exchange_weak(head, slot, std::memory_order_release,
+                                              std::memory_order_relaxed));
+}
+
+void MessagePool::grow() {
+    const std::size_t words = slot_size_ / sizeof(std::max_align_t);
+    slabs_.emplace_back(new std::max_align_t[words * kSlabSlots]);
+    std::max_align_t* base = slabs_.back().get();
+    for (std::size_t i = kSlabSlots; i-- > 0; ) {
+        auto* slot = reinterpret_cast<FreeSlot*>(base + i * words);
+        slot->next = local_;
+        local_ = slot;
+    }
+}
@@ -0,0 +1,63 @@
+// MessagePool.h
+// Per-connection storage for Message objects. Every message type fits in
+// one fixed-size slot (see kMaxMessageSize in MessageFactory.h); slots are
+// carved from slabs that live as long as the connection.
+//
+// The reactor is the only thread that allocates and the client's drain the
+// only one that frees, so allocation pops a private list, frees push onto
+// an atomic stack, and the allocator takes that whole stack with a single
+// exchange when its private list runs dry. No lock, no ABA.
+
+#pragma once
+
+#include "Message.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+class MessagePool {
+public:
+    static constexpr std::size_t kSlabSlots = 32;
+
+    explicit MessagePool(std::size_t slot_size);
+    ~MessagePool();
+
+    MessagePool(const MessagePool&) = delete;
+    MessagePool& operator=(const MessagePool&) = delete;
+
+    // Allocating thread only. Construct a T in a slot; the returned pointer
+    // hands the slot back when destroyed.
+    template <typename T, typename... Args>
+    MessagePtr create(Args&&... args) {
+        static_assert(alignof(T) <= alignof(std::max_align_t));
+        assert(sizeof(T) <= slot_size_);
+        void* mem = allocate();
+        try {
+            return MessagePtr(new (mem) T(std::forward<Args>(args)...), MessageDeleter{this});
+        } catch (...) {
+            deallocate(mem);
+            throw;
+        }
+    }
+
+    // Any single thread at a time (the owner of the message).
+    void deallocate(void* p);
+
+private:
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    void* allocate();
+    void grow();
+
+    const std::size_t slot_size_;
+    FreeSlot* local_ = nullptr;                 // allocator's private list
+    std::atomic<FreeSlot*> returned_{nullptr};  // slots freed by the drain
+    std::vector<std::unique_ptr<std::max_align_t[]>> slabs_;
+};
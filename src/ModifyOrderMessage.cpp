@@ -0,0 +1,40 @@
+#include "ModifyOrderMessage.h"
+#include "MessagePool.h"
+#include "Client.h"
+#include "MatchingEngine.h"
+
+
+ModifyOrderMessage::ModifyOrderMessage(MessageType type_, json j) : OrderMessage(type_) {
+    if (j.contains("symbol")) {
+        symbol = j["symbol"].get<std::string>();
+    }
+    if (!j.contains("order_id") || !j.contains("price") || !j.contains("quantity")) {
+        valid_ = false;
+    } else {
+        order_id = j["order_id"].get<std::uint64_t>();
+        price = j["price"].get<int>();
+        quantity = j["quantity"].get<int>();
+    }
+}
+
+MessagePtr ModifyOrderMessage::fromBinary(MessageType type_, std::string_view payload, MessagePool& pool) {
+    wire::ModifyOrderRequest req;
+    if (!wire::readPod(payload, req)) return nullptr;
+    MessagePtr out = pool.create<ModifyOrderMessage>(type_);
+    auto* msg = static_cast<ModifyOrderMessage*>(out.get());
+    msg->symbol = std::string(wire::fixedString(req.symbol, sizeof(req.symbol)));
+    msg->order_id = req.order_id;
+    msg->price = req.price;
+    msg->quantity = req.quantity;
+    return out;
+}
+
+const json& ModifyOrderMessage::handle(Client& client) {
+    MatchingEngine* engine = client.matchingEngine();
+    if (valid_ && engine) {
+        result_ = engine->modifyOrder(client.sessionId(), symbol, order_id, price, quantity, reports_, lsn_);
+    } else {
+        valid_ = false;
+    }
+    return finish();
+}
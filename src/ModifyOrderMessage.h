@@ -0,0 +1,19 @@
+#pragma once
+
+#include "OrderMessage.h"
+
+#include <memory>
+#include <string_view>
+
+class ModifyOrderMessage : public OrderMessage {
+    std::uint64_t order_id = 0;
+    int price = 0;
+    int quantity = 0;
+    ModifyOrderMessage(MessageType type_) : OrderMessage(type_) {}
+    friend class MessagePool;
+public:
+    ModifyOrderMessage(MessageType type_, json j);
+    // Decode a wire::ModifyOrderRequest payload; nullptr if malformed.
+    static MessagePtr fromBinary(MessageType type_, std::string_view payload, MessagePool& pool);
+    const json& handle(Client& client) override;
+};
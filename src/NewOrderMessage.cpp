@@ -0,0 +1,48 @@
+#include "NewOrderMessage.h"
+#include "MessagePool.h"
+#include "Client.h"
+#include "MatchingEngine.h"
+
+
+NewOrderMessage::NewOrderMessage(MessageType type_, json j) : OrderMessage(type_) {
+    if (j.contains("symbol")) {
+        symbol = j["symbol"].get<std::string>();
+    }
+    std::string s = j.value("side", "");
+    if (s == "buy") {
+        side = Side::Buy;
+    } else if (s == "sell") {
+        side = Side::Sell;
+    } else {
+        valid_ = false;
+    }
+    if (!j.contains("price") || !j.contains("quantity")) {
+        valid_ = false;
+    } else {
+        price = j["price"].get<int>();
+        quantity = j["quantity"].get<int>();
+    }
+}
+
+MessagePtr NewOrderMessage::fromBinary(MessageType type_, std::string_view payload, MessagePool& pool) {
+    wire::NewOrderRequest req;
+    if (!wire::readPod(payload, req)) return nullptr;
+    MessagePtr out = pool.create<NewOrderMessage>(type_);
+    auto* msg = static_cast<NewOrderMessage*>(out.get());
+    msg->symbol = std::string(wire::fixedString(req.symbol, sizeof(req.symbol)));
+    msg->side = req.side == 0 ? Side::Buy : Side::Sell;
+    msg->valid_ = req.side <= 1;
+    msg->price = req.price;
+    msg->quantity = req.quantity;
+    return out;
+}
+
+const json& NewOrderMessage::handle(Client& client) {
+    MatchingEngine* engine = client.matchingEngine();
+    if (valid_ && engine) {
+        result_ = engine->newOrder(client.sessionId(), symbol, side, price, quantity, reports_, lsn_);
+    } else {
+        valid_ = false;
+    }
+    return finish();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "OrderMessage.h"
+
+#include <memory>
+#include <string_view>
+
+class NewOrderMessage : public OrderMessage {
+    Side side = Side::Buy;
+    int price = 0;
+    int quantity = 0;
+    NewOrderMessage(MessageType type_) : OrderMessage(type_) {}
+    friend class MessagePool;
+public:
+    NewOrderMessage(MessageType type_, json j);
+    // Decode a wire::NewOrderRequest payload; nullptr if malformed.
+    static MessagePtr fromBinary(MessageType type_, std::string_view payload, MessagePool& pool);
+    const json& handle(Client& client) override;
+};
@@ -1,70 +1,407 @@
 #include "OrderBook.h"
 
-OrderBook::OrderBook() = default;
+#include <algorithm>
+#include <cmath>
+#include <random>
 
-OrderBook::OrderBook(int fair_price, int max_volume) : mid_price_(fair_price), max_volume_(max_volume) {
-    rebuildAround();
+static std::uint64_t streamKey(std::uint64_t key) {
+    if (key != 0) return key;
+    std::random_device rd;
+    return (std::uint64_t{rd()} << 32) | rd();
 }
 
-OrderBook::OrderBook(int fair_price, int max_volume, const buildParams& params) 
-            : mid_price_(fair_price), max_volume_(max_volume), params_(params) {
-    rebuildAround();
+OrderBook::OrderBook() : levels_(kWindow), rng_(streamKey(0)) {
+    initDecay();
 }
 
-json OrderBook::getTop5OfBook() const {
-    json j;
-    if (!bids.empty()) {
-        for (auto it = bids.begin(); it != bids.end() && j["buy"].size() < 5; ++it) {
-            j["buy"].push_back({{"price", it->first}, {"volume", it->second}});
+OrderBook::OrderBook(int fair_price, int max_volume, std::uint64_t rng_key)
+            : levels_(kWindow), base_(fair_price - kWindow / 2), rng_(streamKey(rng_key)),
+              mid_price_(fair_price), max_volume_(max_volume) {
+    initDecay();
+    std::vector<ExecutionReport> scratch;
+    rebuildAround(scratch);
+}
+
+OrderBook::OrderBook(int fair_price, int max_volume, const buildParams& params, std::uint64_t rng_key)
+            : levels_(kWindow), base_(fair_price - kWindow / 2), rng_(streamKey(rng_key)),
+              mid_price_(fair_price), max_volume_(max_volume), params_(params) {
+    initDecay();
+    std::vector<ExecutionReport> scratch;
+    rebuildAround(scratch);
+}
+
+void OrderBook::initDecay() {
+    const double lambda0 = 0.75 * max_volume_;
+    for (int i = 0; i < kQuoteLevels; ++i) decay_[i] = lambda0 * std::exp(-params_.d * i);
+}
+
+void OrderBook::writeTop5OfBook(JsonWriter& w) const {
+    PriceLevel levels[5];
+    w.beginObject();
+    writeLevels(w.key("buy"), levels, getTopBids(levels, 5));
+    writeLevels(w.key("sell"), levels, getTopAsks(levels, 5));
+    w.endObject();
+}
+
+void writeLevels(JsonWriter& w, const PriceLevel* levels, std::size_t n) {
+    if (n == 0) {
+        w.null();
+        return;
+    }
+    w.beginArray();
+    for (std::size_t i = 0; i < n; ++i) {
+        w.beginObject().key("price").value(levels[i].price).key("volume").value(levels[i].volume).endObject();
+    }
+    w.endArray();
+}
+
+void diffLevels(Side side, const PriceLevel* before, std::size_t nb,
+                const PriceLevel* after, std::size_t na, std::vector<LevelChange>& out) {
+    // top-N lists are short; a nested scan beats anything clever
+    for (std::size_t i = 0; i < nb; ++i) {
+        bool kept = false;
+        for (std::size_t k = 0; k < na && !kept; ++k) kept = after[k].price == before[i].price;
+        if (!kept) out.push_back({side, LevelAction::Delete, before[i].price, 0});
+    }
+    for (std::size_t k = 0; k < na; ++k) {
+        const PriceLevel* old = nullptr;
+        for (std::size_t i = 0; i < nb && !old; ++i) {
+            if (before[i].price == after[k].price) old = &before[i];
+        }
+        if (!old) {
+            out.push_back({side, LevelAction::Add, after[k].price, after[k].volume});
+        } else if (old->volume != after[k].volume) {
+            out.push_back({side, LevelAction::Update, after[k].price, after[k].volume});
         }
+    }
+}
+
+std::size_t applyLevelChange(Side side, PriceLevel* levels, std::size_t n, std::size_t cap,
+                             const LevelChange& change) {
+    auto better = [side](int a, int b) { return side == Side::Buy ? a > b : a < b; };
+    std::size_t i = 0;
+    while (i < n && better(levels[i].price, change.price)) ++i;
+    const bool found = i < n && levels[i].price == change.price;
+    if (change.action == LevelAction::Delete) {
+        if (!found) return n;
+        std::copy(levels + i + 1, levels + n, levels + i);
+        return n - 1;
+    }
+    if (found) {
+        levels[i].volume = change.volume;
+        return n;
+    }
+    if (i == cap) return n;     // below the top levels
+    if (n == cap) --n;          // push the worst one out
+    std::copy_backward(levels + i, levels + n, levels + n + 1);
+    levels[i] = {change.price, change.volume};
+    return n + 1;
+}
+
+size_t OrderBook::getTopBids(PriceLevel* out, size_t n) const {
+    size_t k = 0;
+    for (int i = best_bid_; i >= 0 && k < n; --i) {
+        if (levels_[i].volume > 0) out[k++] = {priceAt(i), levels_[i].volume};
+    }
+    return k;
+}
+
+size_t OrderBook::getTopAsks(PriceLevel* out, size_t n) const {
+    size_t k = 0;
+    for (int i = best_ask_; i < kWindow && k < n; ++i) {
+        if (levels_[i].volume > 0) out[k++] = {priceAt(i), levels_[i].volume};
+    }
+    return k;
+}
+
+std::uint32_t OrderBook::allocOrder() {
+    if (free_head_ != kNil) {
+        std::uint32_t slot = free_head_;
+        free_head_ = orders_[slot].next;
+        return slot;
+    }
+    orders_.emplace_back();
+    return static_cast<std::uint32_t>(orders_.size() - 1);
+}
+
+void OrderBook::freeOrder(std::uint32_t slot) {
+    orders_[slot].next = free_head_;
+    free_head_ = slot;
+}
+
+void OrderBook::unlink(std::uint32_t slot) {
+    Order& o = orders_[slot];
+    Level& lv = levels_[o.price - base_];
+    if (o.prev != kNil) orders_[o.prev].next = o.next; else lv.head = o.next;
+    if (o.next != kNil) orders_[o.next].prev = o.prev; else lv.tail = o.prev;
+    lv.volume -= o.qty;
+}
+
+void OrderBook::rest(std::uint64_t id, std::uint32_t owner, Side side, int price, int qty) {
+    std::uint32_t slot = allocOrder();
+    int idx = price - base_;
+    Level& lv = levels_[idx];
+    orders_[slot] = Order{id, owner, price, qty, lv.tail, kNil, side};
+    if (lv.tail != kNil) orders_[lv.tail].next = slot; else lv.head = slot;
+    lv.tail = slot;
+    lv.volume += qty;
+    index_[id] = slot;
+    if (side == Side::Buy) {
+        best_bid_ = std::max(best_bid_, idx);
     } else {
-        j["buy"] = nullptr;
+        best_ask_ = std::min(best_ask_, idx);
     }
+}
 
-    if (!asks.empty()) {
-        for (auto it = asks.begin(); it != asks.end() && j["sell"].size() < 5; ++it) {
-            j["sell"].push_back({{"price", it->first}, {"volume", it->second}});
+// Take liquidity from the opposite side up to the limit price. Returns the
+// aggressor's leaves quantity.
+int OrderBook::match(std::uint64_t id, std::uint32_t owner, Side side, int price, int qty,
+                     std::vector<ExecutionReport>& out) {
+    const int limit = price - base_;
+    while (qty > 0) {
+        int idx;
+        if (side == Side::Buy) {
+            if (best_ask_ >= kWindow || best_ask_ > limit) break;
+            idx = best_ask_;
+        } else {
+            if (best_bid_ < 0 || best_bid_ < limit) break;
+            idx = best_bid_;
         }
-    } else {
-        j["sell"] = nullptr;
-    }
-    return j;
-}
-
-void OrderBook::rebuildAround() {
-    asks.clear();
-    bids.clear();
-    auto& [d, t, round_mult, max_step, max_tick, gap_prob] = params_;
-    
-    std::uniform_int_distribution<int> step_dist(-max_step, max_step);
-    mid_price_ = std::max(1, mid_price_ + step_dist(gen));
-    
-    double lambda0 = 0.75 * max_volume_;
-    std::uniform_real_distribution<> tilt_dist(-t, t);
-    std::uniform_int_distribution<> tick_dist(1, max_tick);
-    std::bernoulli_distribution gap(gap_prob);
-
-    auto priceLevelVolume = [&](int price_level, int price, int side) {
-        double prob = std::exp(-d * price_level);
-        double expected_volume = lambda0 * prob;
-        double volume = expected_volume * (side == 1 ? (1 + tilt_dist(gen)) : (1 - tilt_dist(gen)));
-        
-        if (price % 5 == 0) {
-            volume *= round_mult;
+        Level& lv = levels_[idx];
+        const int px = priceAt(idx);
+        while (qty > 0 && lv.head != kNil) {
+            std::uint32_t slot = lv.head;
+            Order& o = orders_[slot];
+            int f = std::min(qty, o.qty);
+            o.qty -= f;
+            lv.volume -= f;
+            qty -= f;
+            out.push_back({o.id, o.owner, o.qty == 0 ? OrderState::Filled : OrderState::PartiallyFilled,
+                           o.side, o.price, px, f, o.qty});
+            out.push_back({id, owner, qty == 0 ? OrderState::Filled : OrderState::PartiallyFilled,
+                           side, price, px, f, qty});
+            if (o.qty == 0) {
+                lv.head = o.next;
+                if (lv.head != kNil) orders_[lv.head].prev = kNil; else lv.tail = kNil;
+                index_.erase(o.id);
+                freeOrder(slot);
+            }
         }
-        std::poisson_distribution<int> volume_dist(volume);
-        return std::max(1, volume_dist(gen));
+        if (lv.head == kNil) {
+            if (side == Side::Buy) {
+                while (best_ask_ < kWindow && levels_[best_ask_].volume == 0) ++best_ask_;
+            } else {
+                while (best_bid_ >= 0 && levels_[best_bid_].volume == 0) --best_bid_;
+            }
+        }
+    }
+    return qty;
+}
+
+void OrderBook::place(std::uint64_t id, std::uint32_t owner, Side side, int price, int qty,
+                      OrderState ack, std::vector<ExecutionReport>& out) {
+    size_t ack_at = out.size();
+    out.push_back({id, owner, ack, side, price, 0, 0, qty});
+    int leaves = match(id, owner, side, price, qty, out);
+    out[ack_at].leaves_qty = leaves;
+    if (leaves > 0) rest(id, owner, side, price, leaves);
+}
+
+void OrderBook::removeResting(std::uint32_t slot) {
+    Order& o = orders_[slot];
+    int idx = o.price - base_;
+    unlink(slot);
+    index_.erase(o.id);
+    freeOrder(slot);
+    if (levels_[idx].volume == 0) {
+        if (idx == best_bid_) {
+            while (best_bid_ >= 0 && levels_[best_bid_].volume == 0) --best_bid_;
+        } else if (idx == best_ask_) {
+            while (best_ask_ < kWindow && levels_[best_ask_].volume == 0) ++best_ask_;
+        }
+    }
+}
+
+BookResult OrderBook::submit(std::uint64_t id, std::uint32_t owner, Side side, int price, int qty,
+                             std::vector<ExecutionReport>& out) {
+    if (qty <= 0) return BookResult::BadQuantity;
+    if (!inBand(price)) return BookResult::PriceOutOfBand;
+    place(id, owner, side, price, qty, OrderState::New, out);
+    return BookResult::Ok;
+}
+
+BookResult OrderBook::cancel(std::uint64_t id, std::uint32_t owner, std::vector<ExecutionReport>& out) {
+    auto it = index_.find(id);
+    if (it == index_.end()) return BookResult::UnknownOrder;
+    std::uint32_t slot = it->second;
+    const Order o = orders_[slot];
+    if (o.owner != owner) return BookResult::NotOwner;
+    removeResting(slot);
+    out.push_back({o.id, o.owner, OrderState::Cancelled, o.side, o.price, 0, 0, 0});
+    return BookResult::Ok;
+}
+
+BookResult OrderBook::modify(std::uint64_t id, std::uint32_t owner, int price, int qty,
+                             std::vector<ExecutionReport>& out) {
+    auto it = index_.find(id);
+    if (it == index_.end()) return BookResult::UnknownOrder;
+    std::uint32_t slot = it->second;
+    Order& o = orders_[slot];
+    if (o.owner != owner) return BookResult::NotOwner;
+    if (qty <= 0) return BookResult::BadQuantity;
+    if (!inBand(price)) return BookResult::PriceOutOfBand;
+
+    if (price == o.price && qty <= o.qty) {
+        levels_[o.price - base_].volume -= o.qty - qty;
+        o.qty = qty;
+        out.push_back({o.id, o.owner, OrderState::Replaced, o.side, o.price, 0, 0, qty});
+        return BookResult::Ok;
+    }
+    const Side side = o.side;
+    removeResting(slot);
+    place(id, owner, side, price, qty, OrderState::Replaced, out);
+    return BookResult::Ok;
+}
+
+// Slide the level window so it is centred on mid. Resting orders that fall
+// outside the new band are cancelled.
+void OrderBook::recenter(int mid, std::vector<ExecutionReport>& out) {
+    int new_base = mid - kWindow / 2;
+    int shift = new_base - base_;
+    if (shift == 0) return;
+
+    for (int i = 0; i < kWindow; ++i) {
+        int new_idx = i - shift;
+        if (new_idx >= 0 && new_idx < kWindow) continue;
+        while (levels_[i].head != kNil) {
+            std::uint32_t slot = levels_[i].head;
+            const Order o = orders_[slot];
+            unlink(slot);
+            index_.erase(o.id);
+            freeOrder(slot);
+            out.push_back({o.id, o.owner, OrderState::Cancelled, o.side, o.price, 0, 0, 0});
+        }
+    }
+
+    std::vector<Level> shifted(kWindow);
+    for (int i = 0; i < kWindow; ++i) {
+        int new_idx = i - shift;
+        if (new_idx >= 0 && new_idx < kWindow) shifted[new_idx] = levels_[i];
+    }
+    levels_.swap(shifted);
+    base_ = new_base;
+
+    best_bid_ = -1;
+    best_ask_ = kWindow;
+    for (int i = 0; i < kWindow; ++i) {
+        if (levels_[i].volume == 0) continue;
+        Side s = orders_[levels_[i].head].side;
+        if (s == Side::Buy) best_bid_ = i;
+        else if (best_ask_ == kWindow) best_ask_ = i;
+    }
+}
+
+void OrderBook::rebuildAround(std::vector<ExecutionReport>& out) {
+    for (std::uint64_t id : mm_orders_) {
+        auto it = index_.find(id);
+        if (it != index_.end()) removeResting(it->second);
+    }
+    mm_orders_.clear();
+
+    double u[kQuoteDraws];
+    rng_.fill(u, std::size(u));
+    const int max_step = params_.max_step;
+    mid_price_ = std::max(1, mid_price_ - max_step + static_cast<int>(u[0] * (2 * max_step + 1)));
+
+    // keep the quoted range well inside the level window
+    int idx = mid_price_ - base_;
+    if (idx < kWindow / 4 || idx >= kWindow * 3 / 4) {
+        recenter(mid_price_, out);
+    }
+    quote(u, out);
+}
+
+void OrderBook::quote(const double* u, std::vector<ExecutionReport>& out) {
+    const size_t first = out.size();
+    const auto& [d, t, round_mult, max_step, max_tick, gap_prob] = params_;
+
+    // u is one batch of uniforms per rebuild, always the same layout:
+    // [step, tick, gap x 2N, tilt x 2N, volume x 2N], level i's buy side at
+    // 2i and sell side at 2i + 1.
+    constexpr int kSides = 2 * kQuoteLevels;
+    const double* gap_u = u + 2;
+    const double* tilt_u = gap_u + kSides;
+    const double* volume_u = tilt_u + kSides;
+
+    const int tick = 1 + static_cast<int>(u[1] * max_tick);
+    const int buy1 = mid_price_, sell1 = mid_price_ + tick;
+
+    // expected volume per level: decay, then tilt (buys up, sells down),
+    // then the round-price bonus
+    double mean[kSides];
+    for (int k = 0; k < kSides; ++k) {
+        const int level = k / 2;
+        const double tilt = t * (2 * tilt_u[k] - 1);
+        const int price = k % 2 == 0 ? buy1 - level : sell1 + level;
+        mean[k] = decay_[level] * (k % 2 == 0 ? 1 + tilt : 1 - tilt) * (price % 5 == 0 ? round_mult : 1.0);
+    }
+
+    auto post = [&](Side side, int price, int qty) {
+        if (!inBand(price)) return;
+        std::uint64_t id = next_mm_id_++;
+        place(id, 0, side, price, qty, OrderState::New, out);
+        if (index_.count(id)) mm_orders_.push_back(id);
     };
 
-    int tick = tick_dist(gen), buy1 = mid_price_, sell1 = mid_price_ + tick;
-    for (int i = 0; i < 20; ++i) {
-        if (!gap(gen)) {
-            bids[buy1 - i] = priceLevelVolume(i, buy1 - i, 1);
+    for (int k = 0; k < kSides; ++k) {
+        if (gap_u[k] < gap_prob) continue;
+        const int level = k / 2;
+        const int qty = std::max(1, poissonFromUniform(mean[k], volume_u[k]));
+        if (k % 2 == 0) {
+            post(Side::Buy, buy1 - level, qty);
+        } else {
+            post(Side::Sell, sell1 + level, qty);
         }
-        if (!gap(gen)) {
-            asks[sell1 + i] = priceLevelVolume(i, sell1 + i, 0);
+    }
+
+    // only session-owned orders care about what happened
+    out.erase(std::remove_if(out.begin() + first, out.end(),
+                             [](const ExecutionReport& r) { return r.owner == 0; }),
+              out.end());
+}
+
+void OrderBook::restore(const std::vector<RestingOrder>& orders, std::vector<ExecutionReport>& out) {
+    if (orders.empty()) return;
+    int bid = 0, ask = 0;
+    for (const RestingOrder& o : orders) {
+        if (o.side == Side::Buy) bid = std::max(bid, o.price);
+        else ask = ask == 0 ? o.price : std::min(ask, o.price);
+    }
+    int mid = bid && ask ? (bid + ask) / 2 : bid ? bid : ask - 1;
+
+    // only synthetic quotes rest in a book not yet served
+    levels_.assign(kWindow, Level{});
+    orders_.clear();
+    index_.clear();
+    mm_orders_.clear();
+    free_head_ = kNil;
+    best_bid_ = -1;
+    best_ask_ = kWindow;
+    mid_price_ = std::max(1, mid);
+    base_ = mid_price_ - kWindow / 2;
+
+    for (const RestingOrder& o : orders) {
+        if (inBand(o.price) && o.qty > 0) {
+            rest(o.id, o.owner, o.side, o.price, o.qty);
+        } else {
+            out.push_back({o.id, o.owner, OrderState::Cancelled, o.side, o.price, 0, 0, 0});
         }
     }
+    // quoted without the random walk: buys at or below mid, sells above,
+    // so the quotes cannot trade against what was restored
+    double u[kQuoteDraws];
+    rng_.fill(u, std::size(u));
+    quote(u, out);
 }
 
 std::int64_t OrderBook::getNextTickTime() {
@@ -77,6 +414,5 @@ int OrderBook::getMidPrice() const {
 }
 
 void OrderBook::setNextTickTime(std::int64_t now_ms_) {
-    std::uniform_int_distribution<int> dist(min_interval_ms_, max_interval_ms_);
-    next_tick_ms_ = now_ms_ + dist(gen);
+    next_tick_ms_ = now_ms_ + rng_.uniformInt(min_interval_ms_, max_interval_ms_);
 }
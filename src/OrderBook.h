@@ -1,9 +1,14 @@
 #pragma once
 
 #include <nlohmann/json.hpp>
-#include <map>
+#include <cstdint>
+#include <mutex>
 #include <string>
-#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "CounterRng.h"
+#include "JsonWriter.h"
 using nlohmann::json;
 
 struct buildParams {
@@ -15,30 +20,214 @@ struct buildParams {
     double gap_prob; // probability of missing a level
 };
 
+struct PriceLevel {
+    int price;
+    int volume;
+};
+
+enum class Side : std::uint8_t { Buy = 0, Sell = 1 };
+
+enum class LevelAction : std::uint8_t { Add = 0, Update = 1, Delete = 2 };
+
+// One change to a published price level; Delete carries volume 0.
+struct LevelChange {
+    Side side;
+    LevelAction action;
+    int price;
+    int volume;
+};
+
+// Append the changes that turn `before` into `after`, both one side's top
+// levels best first. Applying them to a copy of `before` yields `after`.
+void diffLevels(Side side, const PriceLevel* before, std::size_t nb,
+                const PriceLevel* after, std::size_t na, std::vector<LevelChange>& out);
+
+// The other way round: apply one change of `side` to its best-first top
+// levels (n of at most cap) in place; returns the new count.
+std::size_t applyLevelChange(Side side, PriceLevel* levels, std::size_t n, std::size_t cap,
+                             const LevelChange& change);
+
+// Write one side's levels as [{"price":P,"volume":V},...], null when empty.
+void writeLevels(JsonWriter& w, const PriceLevel* levels, std::size_t n);
+
+enum class OrderState : std::uint8_t { New, PartiallyFilled, Filled, Cancelled, Replaced, Rejected };
+
+enum class BookResult { Ok, UnknownSymbol, UnknownOrder, NotOwner, PriceOutOfBand, BadQuantity };
+
+inline const char* toString(Side side) {
+    return side == Side::Buy ? "buy" : "sell";
+}
+
+inline const char* toString(LevelAction action) {
+    switch (action) {
+    case LevelAction::Add: return "add";
+    case LevelAction::Update: return "update";
+    case LevelAction::Delete: return "delete";
+    }
+    return "unknown";
+}
+
+inline const char* toString(OrderState state) {
+    switch (state) {
+    case OrderState::New: return "new";
+    case OrderState::PartiallyFilled: return "partially_filled";
+    case OrderState::Filled: return "filled";
+    case OrderState::Cancelled: return "cancelled";
+    case OrderState::Replaced: return "replaced";
+    case OrderState::Rejected: return "rejected";
+    }
+    return "unknown";
+}
+
+// One event for one order. Fills carry last_price/last_qty, everything
+// else leaves them 0.
+struct ExecutionReport {
+    std::uint64_t order_id;
+    std::uint32_t owner;    // session id, 0 = synthetic liquidity
+    OrderState state;
+    Side side;
+    int price;              // limit price of the order
+    int last_price;
+    int last_qty;
+    int leaves_qty;
+};
+
+// A session order to put back into a book on recovery.
+struct RestingOrder {
+    std::uint64_t id;
+    std::uint32_t owner;
+    Side side;
+    int price;
+    int qty;
+};
+
+/*
+ Price-time priority limit order book.
+
+ Levels live in a flat array indexed by (price - base_) that covers a band
+ of kWindow ticks around the mid; each level is a FIFO of resting orders
+ linked by index through a pooled order array. Order id -> pool slot gives
+ O(1) cancel. Since a resting book is never crossed, every non-empty level
+ at or below best_bid_ holds bids and every one at or above best_ask_ holds
+ asks, so levels need no side flag.
+
+ Synthetic liquidity from rebuildAround() is just resting orders owned by
+ session 0 that are pulled and re-quoted on each tick.
+
+ Not thread-safe; callers lock mutex(), or run on the engine shard owning
+ the book (EngineShards.h).
+*/
 class OrderBook {
-    std::map<int, int, std::greater<>> bids; // buy orders
-    std::map<int, int> asks;                 // sell orders
-    std::mt19937 gen{std::random_device{}()};
+public:
+    static constexpr int kWindow = 512;      // ticks covered by the level array
+    static constexpr int kQuoteLevels = 20;  // synthetic levels quoted per side
+
+private:
+    static constexpr std::uint32_t kNil = UINT32_MAX;
+
+    struct Level {
+        int volume = 0;
+        std::uint32_t head = kNil;
+        std::uint32_t tail = kNil;
+    };
+
+    struct Order {
+        std::uint64_t id;
+        std::uint32_t owner;
+        int price;
+        int qty;                // leaves quantity
+        std::uint32_t prev;
+        std::uint32_t next;     // also free-list link
+        Side side;
+    };
+
+    std::vector<Level> levels_;
+    std::vector<Order> orders_;
+    std::uint32_t free_head_ = kNil;
+    std::unordered_map<std::uint64_t, std::uint32_t> index_; // order id -> slot
+    int base_ = 0;                  // price of levels_[0]
+    int best_bid_ = -1;             // level index, -1 if no bids
+    int best_ask_ = kWindow;        // level index, kWindow if no asks
+
+    std::vector<std::uint64_t> mm_orders_;      // resting synthetic orders
+    std::uint64_t next_mm_id_ = 1ull << 63;     // synthetic ids never clash with session ids
+    mutable std::mutex mutex_;
+
+    // Own stream per book: a rebuild draws the same numbers whichever
+    // thread runs it.
+    CounterRng rng_;
     std::int64_t next_tick_ms_{0}; // 下次触发 tick 的时间戳（毫秒，unix time）
     int min_interval_ms_ = 2000;
     int max_interval_ms_ = 5000;
     int mid_price_;
-    int max_volume_;
+    int max_volume_ = 0;
 
     buildParams params_{0.15, 0.2, 2.0, 5, 5, 0.33};
+    // Expected volume of quote level i before tilt and rounding:
+    // 0.75 * max_volume * exp(-d * i), fixed by params_.
+    double decay_[kQuoteLevels];
+
+    void initDecay();
+
+    int priceAt(int idx) const { return base_ + idx; }
+    bool inBand(int price) const { return price > 0 && price >= base_ && price < base_ + kWindow; }
+
+    std::uint32_t allocOrder();
+    void freeOrder(std::uint32_t slot);
+    void unlink(std::uint32_t slot);
+    void rest(std::uint64_t id, std::uint32_t owner, Side side, int price, int qty);
+    int match(std::uint64_t id, std::uint32_t owner, Side side, int price, int qty,
+              std::vector<ExecutionReport>& out);
+    void place(std::uint64_t id, std::uint32_t owner, Side side, int price, int qty,
+               OrderState ack, std::vector<ExecutionReport>& out);
+    void removeResting(std::uint32_t slot);
+    void recenter(int mid, std::vector<ExecutionReport>& out);
+    // Place the synthetic quotes around mid_price_ from one batch of
+    // kQuoteDraws uniforms (see rebuildAround()).
+    static constexpr int kQuoteDraws = 2 + 3 * 2 * kQuoteLevels;
+    void quote(const double* u, std::vector<ExecutionReport>& out);
 
 public:
+    // rng_key selects the book's random stream; 0 draws a fresh one.
     OrderBook();
-    OrderBook(int fair_price, int max_volume);
-    OrderBook(int fair_price, int max_volume, const buildParams& params);
+    OrderBook(int fair_price, int max_volume, std::uint64_t rng_key = 0);
+    OrderBook(int fair_price, int max_volume, const buildParams& params, std::uint64_t rng_key = 0);
+
+    OrderBook(const OrderBook&) = delete;
+    OrderBook& operator=(const OrderBook&) = delete;
+
+    std::mutex& mutex() const { return mutex_; }
 
-    json getTop5OfBook() const;
-    void rebuildAround();
+    // Write {"buy":[...],"sell":[...]} of the top 5 levels per side.
+    void writeTop5OfBook(JsonWriter& w) const;
+    // Copy up to n best levels (best first) into out; return the count.
+    size_t getTopBids(PriceLevel* out, size_t n) const;
+    size_t getTopAsks(PriceLevel* out, size_t n) const;
+
+    // Pull synthetic quotes, random-walk the mid and re-quote around it.
+    // Re-quoting may trade against resting session orders; their reports
+    // are appended to out (synthetic-side reports are not).
+    void rebuildAround(std::vector<ExecutionReport>& out);
+
+    // Order entry. Reports for every order touched are appended to out, the
+    // incoming order's acknowledgement first. Nothing is appended on error.
+    BookResult submit(std::uint64_t id, std::uint32_t owner, Side side, int price, int qty,
+                      std::vector<ExecutionReport>& out);
+    BookResult cancel(std::uint64_t id, std::uint32_t owner, std::vector<ExecutionReport>& out);
+    // Quantity decrease at the same price keeps queue position; anything
+    // else re-enters the book (and may trade) at the back of the queue.
+    BookResult modify(std::uint64_t id, std::uint32_t owner, int price, int qty,
+                      std::vector<ExecutionReport>& out);
+
+    // Recovery, before serving: replace the synthetic quotes with `orders`
+    // (priority order within a level), the band and the synthetic quotes
+    // centred between their best bid and ask. Orders outside the band are
+    // cancelled, with their reports appended to out.
+    void restore(const std::vector<RestingOrder>& orders, std::vector<ExecutionReport>& out);
 
-    
     std::int64_t getNextTickTime();
     void setNextTickTime(std::int64_t now_ms_);
 
     int getMidPrice() const;
 
-};
\ No newline at end of file
+};
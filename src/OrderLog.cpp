@@ -0,0 +1,321 @@
+#include "OrderLog.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+static std::uint32_t fnv1a(const void* data, std::size_t n) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    std::uint32_t h = 2166136261u;
+    for (std::size_t i = 0; i < n; ++i) h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+static orderlog::Record toRecord(std::uint32_t symbol, const ExecutionReport& r) {
+    orderlog::Record rec{static_cast<std::uint16_t>(symbol), static_cast<std::uint8_t>(r.state),
+                         static_cast<std::uint8_t>(r.side), r.owner, r.order_id, r.price,
+                         r.last_price, r.last_qty, r.leaves_qty, 0};
+    rec.check = fnv1a(&rec, offsetof(orderlog::Record, check));
+    return rec;
+}
+
+static bool writeAll(int fd, const char* data, std::size_t n) {
+    while (n > 0) {
+        ssize_t w = ::write(fd, data, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += w;
+        n -= static_cast<std::size_t>(w);
+    }
+    return true;
+}
+
+static bool readFile(const std::string& path, std::vector<char>& out) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno == ENOENT;     // first run: nothing to replay
+    struct stat st{};
+    bool ok = fstat(fd, &st) == 0;
+    if (ok) {
+        out.resize(static_cast<std::size_t>(st.st_size));
+        std::size_t got = 0;
+        while (ok && got < out.size()) {
+            ssize_t r = ::read(fd, out.data() + got, out.size() - got);
+            if (r < 0 && errno == EINTR) continue;
+            ok = r > 0;
+            if (ok) got += static_cast<std::size_t>(r);
+        }
+    }
+    if (!ok) std::perror(path.c_str());
+    ::close(fd);
+    return ok;
+}
+
+// The resting session orders left by a sequence of reports.
+namespace {
+struct Live {
+    std::uint32_t symbol;
+    RestingOrder order;
+    std::uint64_t priority;     // time of its last entry into the queue
+};
+}
+
+static void replay(const std::vector<char>& file, const std::vector<std::string>& symbols,
+                   const std::string& path, OrderLogRecovery& out) {
+    std::size_t pos = 0;
+    auto get = [&](void* v, std::size_t n) {
+        if (file.size() - pos < n) return false;
+        std::memcpy(v, file.data() + pos, n);
+        pos += n;
+        return true;
+    };
+
+    orderlog::FileHeader h{};
+    get(&h, sizeof(h));
+    out.next_order_id = std::max(out.next_order_id, h.next_order_id);
+    out.next_session = std::max(out.next_session, h.next_session);
+
+    // logged symbol index -> current id, by name
+    std::unordered_map<std::string, std::uint32_t> ids;
+    for (std::uint32_t i = 0; i < symbols.size(); ++i) ids.emplace(symbols[i], i);
+    std::vector<std::uint32_t> table;
+    for (std::uint32_t i = 0; i < h.symbol_count; ++i) {
+        std::uint16_t len;
+        if (!get(&len, sizeof(len)) || file.size() - pos < len) {
+            std::fprintf(stderr, "%s: truncated symbol table\n", path.c_str());
+            return;
+        }
+        auto it = ids.find(std::string(file.data() + pos, len));
+        table.push_back(it == ids.end() ? UINT32_MAX : it->second);
+        pos += len;
+    }
+
+    std::unordered_map<std::uint64_t, Live> live;
+    std::uint64_t priority = 0;
+    std::size_t unknown = 0;
+    orderlog::Record rec;
+    while (get(&rec, sizeof(rec))) {
+        if (rec.check != fnv1a(&rec, offsetof(orderlog::Record, check)) ||
+            rec.state > static_cast<std::uint8_t>(OrderState::Rejected) || rec.side > 1) {
+            std::fprintf(stderr, "%s: torn record at offset %zu, dropping the rest\n", path.c_str(),
+                         pos - sizeof(rec));
+            break;
+        }
+        ++out.events;
+        out.next_order_id = std::max(out.next_order_id, rec.order_id + 1);
+        out.next_session = std::max(out.next_session, rec.owner + 1);
+        if (rec.symbol >= table.size() || table[rec.symbol] == UINT32_MAX) {
+            ++unknown;
+            continue;
+        }
+        const auto state = static_cast<OrderState>(rec.state);
+        auto it = live.find(rec.order_id);
+        if (state == OrderState::New ||
+            (state == OrderState::Replaced &&
+             (it == live.end() || it->second.order.price != rec.price || rec.leaves_qty > it->second.order.qty))) {
+            // (re-)enters the book at the back of its level
+            live[rec.order_id] = {table[rec.symbol],
+                                  {rec.order_id, rec.owner, static_cast<Side>(rec.side), rec.price, rec.leaves_qty},
+                                  priority++};
+            it = live.find(rec.order_id);
+        } else if (it == live.end()) {
+            continue;
+        }
+        if (state == OrderState::Cancelled || state == OrderState::Rejected || rec.leaves_qty <= 0) {
+            live.erase(it);
+        } else {
+            it->second.order.qty = rec.leaves_qty;  // fill or in-place reduction
+        }
+    }
+    if (unknown > 0) {
+        std::fprintf(stderr, "%s: %zu events of symbols no longer served were skipped\n", path.c_str(), unknown);
+    }
+
+    std::vector<const Live*> resting;
+    resting.reserve(live.size());
+    for (const auto& [id, l] : live) resting.push_back(&l);
+    std::sort(resting.begin(), resting.end(), [](const Live* a, const Live* b) { return a->priority < b->priority; });
+    for (const Live* l : resting) out.books[l->symbol].push_back(l->order);
+    out.orders = resting.size();
+}
+
+OrderLog::~OrderLog() {
+    close();
+}
+
+bool OrderLog::open(const std::string& path, const std::vector<std::string>& symbols, OrderLogRecovery& out) {
+    out = OrderLogRecovery{};
+    out.books.resize(symbols.size());
+    std::vector<char> file;
+    if (!readFile(path, file)) return false;
+    if (!file.empty()) {
+        orderlog::FileHeader h{};
+        if (file.size() >= sizeof(h)) std::memcpy(&h, file.data(), sizeof(h));
+        if (std::memcmp(h.magic, orderlog::kMagic, sizeof(h.magic)) != 0 || h.version != orderlog::kVersion) {
+            std::fprintf(stderr, "%s: not an order log (or another version)\n", path.c_str());
+            return false;
+        }
+        replay(file, symbols, path, out);
+    }
+
+    // Rewrite: header, the current symbol table, one New per recovered order.
+    std::string data;
+    orderlog::FileHeader h{};
+    std::memcpy(h.magic, orderlog::kMagic, sizeof(h.magic));
+    h.version = orderlog::kVersion;
+    h.symbol_count = static_cast<std::uint32_t>(symbols.size());
+    h.next_order_id = out.next_order_id;
+    h.next_session = out.next_session;
+    data.append(reinterpret_cast<const char*>(&h), sizeof(h));
+    for (const auto& name : symbols) {
+        const auto len = static_cast<std::uint16_t>(name.size());
+        data.append(reinterpret_cast<const char*>(&len), sizeof(len));
+        data.append(name);
+    }
+    for (std::uint32_t id = 0; id < out.books.size(); ++id) {
+        for (const RestingOrder& o : out.books[id]) {
+            const ExecutionReport r{o.id, o.owner, OrderState::New, o.side, o.price, 0, 0, o.qty};
+            const orderlog::Record rec = toRecord(id, r);
+            data.append(reinterpret_cast<const char*>(&rec), sizeof(rec));
+        }
+    }
+
+    // new file first, then rename over the old one: a crash leaves either
+    const std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::perror(tmp.c_str());
+        return false;
+    }
+    if (!writeAll(fd, data.data(), data.size()) || fdatasync(fd) < 0 || rename(tmp.c_str(), path.c_str()) < 0) {
+        std::perror(tmp.c_str());
+        ::close(fd);
+        return false;
+    }
+    ::close(fd);
+    const std::size_t slash = path.rfind('/');
+    const std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int dfd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd >= 0) {
+        fsync(dfd);
+        ::close(dfd);
+    }
+
+    fd_ = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (fd_ < 0) {
+        std::perror(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void OrderLog::start() {
+    if (thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(ack_mutex_);
+        closed_ = false;
+    }
+    stopping_ = false;
+    thread_ = std::thread([this] { run(); });
+}
+
+void OrderLog::close() {
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        ready_.notify_one();
+        thread_.join();
+    }
+    // nothing commits any more; whatever still waits runs now
+    std::multimap<std::uint64_t, std::function<void()>> rest;
+    {
+        std::lock_guard<std::mutex> lock(ack_mutex_);
+        closed_ = true;
+        rest.swap(waiting_);
+    }
+    for (auto& [lsn, fn] : rest) fn();
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+std::uint64_t OrderLog::append(std::uint32_t symbol, const ExecutionReport* reports, std::size_t n) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const bool was_empty = buffer_.empty();
+    for (std::size_t i = 0; i < n; ++i) {
+        if (reports[i].owner == 0) continue;
+        const orderlog::Record rec = toRecord(symbol, reports[i]);
+        const char* p = reinterpret_cast<const char*>(&rec);
+        buffer_.insert(buffer_.end(), p, p + sizeof(rec));
+        appended_ += sizeof(rec);
+    }
+    // the thread only sleeps on an empty buffer
+    if (was_empty && !buffer_.empty()) ready_.notify_one();
+    return appended_;
+}
+
+std::uint64_t OrderLog::appended() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return appended_;
+}
+
+void OrderLog::whenDurable(std::uint64_t lsn, std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(ack_mutex_);
+        if (lsn > durable_ && !closed_) {
+            waiting_.emplace(lsn, std::move(fn));
+            return;
+        }
+    }
+    // every earlier callback has run: complete() runs them before moving durable_
+    fn();
+}
+
+void OrderLog::run() {
+    std::vector<char> batch;
+    for (;;) {
+        std::uint64_t end;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [this] { return !buffer_.empty() || stopping_; });
+            if (buffer_.empty()) break;
+            batch.swap(buffer_);
+            end = appended_;
+        }
+        // whatever is appended meanwhile goes into the next commit
+        commit(batch);
+        batch.clear();
+        complete(end);
+    }
+}
+
+bool OrderLog::commit(const std::vector<char>& batch) {
+    if (fd_ < 0) return false;
+    if (!writeAll(fd_, batch.data(), batch.size()) || fdatasync(fd_) < 0) {
+        // like the market data journal: report, then carry on without it
+        std::perror("order log: write");
+        std::fprintf(stderr, "order log: disabled, orders are no longer durable\n");
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    ++commits_;
+    return true;
+}
+
+void OrderLog::complete(std::uint64_t lsn) {
+    std::lock_guard<std::mutex> lock(ack_mutex_);
+    auto end = waiting_.upper_bound(lsn);
+    for (auto it = waiting_.begin(); it != end; ++it) it->second();
+    waiting_.erase(waiting_.begin(), end);
+    durable_ = lsn;
+}
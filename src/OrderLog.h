@@ -0,0 +1,137 @@
+// OrderLog.h
+// Write-ahead log of order events: every execution report of a session
+// order (acknowledgement, fill, cancel, replace) is appended before the
+// request is answered, and the answer only goes out once the log is on
+// disk. Appends are a memcpy under a mutex; a dedicated thread writes
+// whatever accumulated and fdatasyncs it, so the events of every request
+// that arrived during one sync share the next (group commit) and no
+// reactor or worker ever waits for the disk.
+//
+// On startup the log is replayed into the resting session orders of each
+// book and rewritten to just those (the rest of the history is dropped),
+// then appended to. Layout (packed, little-endian):
+//
+//   FileHeader
+//   symbol_count times { u16 length, name }    ids are table positions
+//   Record...                                  one per execution report
+//
+// Replay stops at the first torn or corrupt record.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "OrderBook.h"
+
+namespace orderlog {
+
+constexpr char kMagic[8] = {'T', 'S', 'O', 'R', 'D', 'W', 'A', 'L'};
+constexpr std::uint32_t kVersion = 1;
+
+#pragma pack(push, 1)
+struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t symbol_count;
+    std::uint64_t next_order_id;    // ids below were used before the rewrite
+    std::uint32_t next_session;     // session ids likewise
+    std::uint32_t reserved;
+};
+
+struct Record {
+    std::uint16_t symbol;       // index into the symbol table
+    std::uint8_t state;         // OrderState
+    std::uint8_t side;          // Side
+    std::uint32_t owner;        // session id
+    std::uint64_t order_id;
+    std::int32_t price;
+    std::int32_t last_price;
+    std::int32_t last_qty;
+    std::int32_t leaves_qty;
+    std::uint32_t check;        // FNV-1a of the bytes above
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FileHeader) == 32);
+static_assert(sizeof(Record) == 36);
+
+} // namespace orderlog
+
+// What replaying the log left behind.
+struct OrderLogRecovery {
+    std::uint64_t next_order_id = 1;
+    std::uint32_t next_session = 1;
+    std::size_t events = 0;                         // records replayed
+    std::size_t orders = 0;                         // resting orders recovered
+    std::vector<std::vector<RestingOrder>> books;   // by symbol id, priority order
+};
+
+class OrderLog {
+public:
+    OrderLog() = default;
+    ~OrderLog();
+
+    OrderLog(const OrderLog&) = delete;
+    OrderLog& operator=(const OrderLog&) = delete;
+
+    // Replay the log at path (if any) for the books of `symbols` into out,
+    // rewrite it to the recovered orders and open it for appending.
+    // Return false on error (reported with perror).
+    bool open(const std::string& path, const std::vector<std::string>& symbols, OrderLogRecovery& out);
+
+    // Start the commit thread; appends before this are committed with the
+    // first batch.
+    void start();
+    // Commit what is appended, run the waiting callbacks and stop the
+    // thread. Callbacks registered afterwards run right away.
+    void close();
+
+    // Any thread, under the book's lock (or on its shard) so a book's
+    // events are logged in the order they happened. Reports of synthetic
+    // orders are skipped.
+    // Returns the log position to wait for (appended() after the append).
+    std::uint64_t append(std::uint32_t symbol, const ExecutionReport* reports, std::size_t n);
+    std::uint64_t append(std::uint32_t symbol, const std::vector<ExecutionReport>& reports) {
+        return append(symbol, reports.data(), reports.size());
+    }
+    // Position past everything appended so far.
+    std::uint64_t appended();
+
+    // Run fn once the log is durable up to lsn: right away if it already
+    // is, otherwise on the commit thread, callbacks in lsn order (and in
+    // registration order for the same lsn).
+    void whenDurable(std::uint64_t lsn, std::function<void()> fn);
+
+    std::uint64_t commits() const { return commits_; }
+
+private:
+    void run();
+    // Write and sync one batch; false (reported) if the file failed.
+    bool commit(const std::vector<char>& batch);
+    // Everything up to lsn is durable: run the callbacks waiting for it.
+    void complete(std::uint64_t lsn);
+
+    int fd_ = -1;
+    std::thread thread_;
+
+    std::mutex mutex_;                  // guards the append side
+    std::condition_variable ready_;
+    std::vector<char> buffer_;          // appended, not yet handed to the thread
+    std::uint64_t appended_ = 0;        // bytes appended since open (lsn)
+    bool stopping_ = false;
+
+    std::mutex ack_mutex_;              // guards the durable side
+    std::uint64_t durable_ = 0;         // callbacks up to here have run
+    bool closed_ = true;                // no thread: callbacks run inline
+    std::multimap<std::uint64_t, std::function<void()>> waiting_;
+
+    std::uint64_t commits_ = 0;         // commit thread only
+};
@@ -0,0 +1,69 @@
+#include "OrderMessage.h"
+
+static const char* describe(BookResult result) {
+    switch (result) {
+    case BookResult::Ok: return "ok";
+    case BookResult::UnknownSymbol: return "Unknown symbol";
+    case BookResult::UnknownOrder: return "Unknown order";
+    case BookResult::NotOwner: return "Order belongs to another session";
+    case BookResult::PriceOutOfBand: return "Price outside of band";
+    case BookResult::BadQuantity: return "Quantity must be positive";
+    }
+    return "error";
+}
+
+const json& OrderMessage::finish() {
+    if (!valid_) {
+        status_code_ = 400;
+    } else {
+        switch (result_) {
+        case BookResult::Ok: status_code_ = 200; break;
+        case BookResult::UnknownSymbol:
+        case BookResult::UnknownOrder: status_code_ = 404; break;
+        case BookResult::NotOwner: status_code_ = 403; break;
+        default: status_code_ = 400; break;
+        }
+    }
+    toJson();
+    return data_;
+}
+
+void OrderMessage::toJson() {
+    Message::toJson();
+    if (status_code_ != 200) {
+        data_["error"] = valid_ ? describe(result_) : "Malformed order request";
+        return;
+    }
+    const ExecutionReport& ack = reports_.front();
+    const ExecutionReport& last = reports_.back();
+    data_["symbol"] = symbol;
+    data_["order_id"] = ack.order_id;
+    data_["side"] = toString(ack.side);
+    data_["price"] = ack.price;
+    data_["state"] = toString(reports_.size() > 1 ? last.state : ack.state);
+    data_["leaves_qty"] = last.leaves_qty;
+    json fills = json::array();
+    for (size_t i = 1; i < reports_.size(); ++i) {
+        fills.push_back({{"price", reports_[i].last_price}, {"quantity", reports_[i].last_qty}});
+    }
+    data_["fills"] = std::move(fills);
+}
+
+void OrderMessage::toBinary(std::string& out) const {
+    std::size_t at = wire::beginFrame(out, static_cast<std::uint16_t>(getType()), seq_);
+    wire::OrderResponse resp{};
+    resp.status = status_code_;
+    if (status_code_ == 200) {
+        const ExecutionReport& ack = reports_.front();
+        const ExecutionReport& last = reports_.back();
+        resp.order_id = ack.order_id;
+        resp.state = static_cast<std::uint8_t>(reports_.size() > 1 ? last.state : ack.state);
+        resp.leaves_qty = last.leaves_qty;
+        resp.fill_count = static_cast<std::uint16_t>(reports_.size() - 1);
+    }
+    wire::appendPod(out, resp);
+    for (size_t i = 1; status_code_ == 200 && i < reports_.size(); ++i) {
+        wire::appendPod(out, wire::Fill{reports_[i].last_price, reports_[i].last_qty});
+    }
+    wire::endFrame(out, at);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Message.h"
+#include "OrderBook.h"
+
+#include <vector>
+
+// Common response handling for new/cancel/modify order requests.
+// Derived classes fill symbol/reports_/result_ in handle() and call finish().
+class OrderMessage : public Message {
+protected:
+    std::string symbol;
+    bool valid_ = true;         // request fields parsed correctly
+    BookResult result_ = BookResult::Ok;
+    std::vector<ExecutionReport> reports_; // own order: acknowledgement first, then fills
+    std::uint64_t lsn_ = 0;     // order log position of the request's events
+
+    OrderMessage(MessageType type_) : Message(type_) {}
+
+    // Set status code from valid_/result_ and build the JSON response.
+    const json& finish();
+public:
+    void toJson() override;
+    void toBinary(std::string& out) const override;
+    std::uint64_t durableAt() const override { return lsn_; }
+    std::string_view bookSymbol() const override { return symbol; }
+};
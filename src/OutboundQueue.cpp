@@ -0,0 +1,202 @@
+#include "OutboundQueue.h"
+
+#include "ServerStats.h"
+#include "Tsc.h"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+ChunkPool& ChunkPool::instance() {
+    static ChunkPool pool;
+    return pool;
+}
+
+ChunkPool::~ChunkPool() {
+    for (Chunk* c : free_) delete c;
+}
+
+ChunkPool::Chunk* ChunkPool::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            Chunk* c = free_.back();
+            free_.pop_back();
+            return c;
+        }
+    }
+    return new Chunk;
+}
+
+void ChunkPool::release(Chunk* chunk) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.size() < kMaxCached) {
+            free_.push_back(chunk);
+            return;
+        }
+    }
+    delete chunk;
+}
+
+OutboundQueue::~OutboundQueue() {
+    for (auto& seg : segments_) {
+        if (seg.chunk) ChunkPool::instance().release(seg.chunk);
+    }
+}
+
+bool OutboundQueue::append(const char* data, std::size_t len) {
+    if (len == 0) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool was_empty = bytes_ == 0;
+    bytes_ += len;
+    while (len > 0) {
+        if (segments_.empty() || !segments_.back().chunk ||
+            segments_.back().end == ChunkPool::kChunkSize) {
+            Segment seg;
+            seg.chunk = ChunkPool::instance().acquire();
+            segments_.push_back(std::move(seg));
+        }
+        Segment& tail = segments_.back();
+        if (tail.queued_tsc == 0) tail.queued_tsc = tsc::now();
+        std::size_t n = std::min(len, ChunkPool::kChunkSize - tail.end);
+        std::memcpy(tail.chunk->data + tail.end, data, n);
+        tail.end += n;
+        data += n;
+        len -= n;
+    }
+    return was_empty;
+}
+
+bool OutboundQueue::append(SharedBuffer buf, std::uint32_t tag) {
+    if (!buf || buf->empty()) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool was_empty = bytes_ == 0;
+    bytes_ += buf->size();
+    Segment seg;
+    seg.end = buf->size();
+    seg.shared = std::move(buf);
+    seg.tag = tag;
+    seg.queued_tsc = tsc::now();
+    segments_.push_back(std::move(seg));
+    return was_empty;
+}
+
+bool OutboundQueue::replaceTagged(std::uint32_t tag, SharedBuffer buf) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // begin > 0: partly sent, must finish. Only the flusher advances begin
+    // and it runs on this thread, so no gathered iovec points at these;
+    // pinned ones are being sent asynchronously.
+    auto first = segments_.begin() + static_cast<std::ptrdiff_t>(std::min(pinned_, segments_.size()));
+    segments_.erase(std::remove_if(first, segments_.end(), [this, tag](const Segment& seg) {
+        if (seg.chunk || seg.tag != tag || seg.begin != 0) return false;
+        bytes_ -= seg.end;
+        return true;
+    }), segments_.end());
+    bool was_empty = bytes_ == 0;
+    if (buf && !buf->empty()) {
+        bytes_ += buf->size();
+        Segment seg;
+        seg.end = buf->size();
+        seg.shared = std::move(buf);
+        seg.tag = tag;
+        seg.queued_tsc = tsc::now();
+        segments_.push_back(std::move(seg));
+    }
+    return was_empty;
+}
+
+ssize_t OutboundQueue::flush(int fd) {
+    ssize_t total = 0;
+    iovec iov[kMaxIov];
+    for (;;) {
+        std::size_t cnt = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::size_t spanned;
+            cnt = gatherLocked(iov, kMaxIov, spanned);
+        }
+        if (cnt == 0) break;
+
+        msghdr mh{};
+        mh.msg_iov = iov;
+        mh.msg_iovlen = cnt;
+        ssize_t n = sendmsg(fd, &mh, MSG_NOSIGNAL);
+        if (n > 0) {
+            total += n;
+            std::lock_guard<std::mutex> lock(mutex_);
+            consume(static_cast<std::size_t>(n));
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break; // try later when writable
+        }
+        if (n < 0 && errno == EINTR) continue;
+        return -1;
+    }
+    return total;
+}
+
+std::size_t OutboundQueue::gatherLocked(iovec* iov, std::size_t max, std::size_t& spanned) const {
+    std::size_t cnt = 0;
+    spanned = 0;
+    for (auto it = segments_.begin(); it != segments_.end() && cnt < max; ++it) {
+        ++spanned;
+        if (it->begin == it->end) continue;
+        iov[cnt].iov_base = const_cast<char*>(it->data() + it->begin);
+        iov[cnt].iov_len = it->end - it->begin;
+        ++cnt;
+    }
+    return cnt;
+}
+
+std::size_t OutboundQueue::gather(iovec* iov, std::size_t max) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return gatherLocked(iov, max, pinned_);
+}
+
+void OutboundQueue::completeSend(std::size_t sent) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pinned_ = 0;
+    if (sent > 0) consume(sent);
+}
+
+// Caller holds mutex_.
+void OutboundQueue::consume(std::size_t n) {
+    bytes_ -= n;
+    ServerStats& stats = ServerStats::instance();
+    const std::uint64_t now = tsc::now();
+    while (n > 0) {
+        Segment& front = segments_.front();
+        std::size_t avail = front.end - front.begin;
+        if (n < avail) {
+            front.begin += n;
+            return;
+        }
+        n -= avail;
+        front.begin = front.end;
+        // 0: the kept tail chunk, emptied and not written to since
+        if (front.queued_tsc) stats.record(ServerStats::Stage::OutboundWait, now - front.queued_tsc);
+        // keep a fully-read tail chunk: producers may still be filling it
+        if (front.chunk && segments_.size() == 1 && front.end < ChunkPool::kChunkSize) {
+            front.begin = front.end = 0;
+            front.queued_tsc = 0;
+            return;
+        }
+        if (front.chunk) ChunkPool::instance().release(front.chunk);
+        segments_.pop_front();
+    }
+}
+
+bool OutboundQueue::empty() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_ == 0;
+}
+
+std::size_t OutboundQueue::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
@@ -0,0 +1,121 @@
+// OutboundQueue.h
+// Per-connection outbound byte queue: a chain of segments, each either a
+// fixed-size chunk from a shared ChunkPool (private responses are copied
+// in, no per-message allocation) or a reference to an immutable shared
+// buffer (market data). The flusher keeps a read cursor into the front
+// segment, so consuming sent bytes never shifts the backlog.
+//
+// Shared segments may carry a tag (the market data symbol they update) so
+// a slow consumer's unsent market data can be replaced by fresher state.
+//
+// Producers (worker threads, the engine, the reactor) append under a short
+// lock. flush() only holds that lock while gathering iovecs and while
+// advancing the cursor, not across sendmsg: chunks never move, appends only
+// write past what was gathered, and segments are only released by the
+// flusher, so a slow flush does not block producers.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+struct iovec;
+
+using SharedBuffer = std::shared_ptr<const std::string>;
+
+class ChunkPool {
+public:
+    static constexpr std::size_t kChunkSize = 16 * 1024;
+    static constexpr std::size_t kMaxCached = 1024;   // 16 MiB kept for reuse
+
+    struct Chunk {
+        char data[kChunkSize];
+    };
+
+    static ChunkPool& instance();
+
+    Chunk* acquire();
+    void release(Chunk* chunk);
+
+private:
+    ChunkPool() = default;
+    ~ChunkPool();
+
+    std::mutex mutex_;
+    std::vector<Chunk*> free_;
+};
+
+class OutboundQueue {
+public:
+    static constexpr std::uint32_t kNoTag = static_cast<std::uint32_t>(-1);
+
+    OutboundQueue() = default;
+    ~OutboundQueue();
+
+    OutboundQueue(const OutboundQueue&) = delete;
+    OutboundQueue& operator=(const OutboundQueue&) = delete;
+
+    // Append bytes; return true if the queue was empty before (the caller
+    // should arm write interest).
+    bool append(const char* data, std::size_t len);
+    bool append(SharedBuffer buf, std::uint32_t tag = kNoTag);
+
+    // Flusher's thread only: drop every segment tagged `tag` that has not
+    // started to go out, then append buf with that tag. Returns true if the
+    // queue was empty before.
+    bool replaceTagged(std::uint32_t tag, SharedBuffer buf);
+
+    // Single flusher only. Send as much as the socket accepts.
+    // Returns bytes sent, or -1 on a hard socket error.
+    ssize_t flush(int fd);
+
+    // Asynchronous flush (io_uring): gather up to max unsent ranges without
+    // sending. The gathered segments stay pinned -- replaceTagged() leaves
+    // them alone -- until completeSend() reports how many bytes went out.
+    // Single flusher, one gather outstanding at a time.
+    std::size_t gather(iovec* iov, std::size_t max);
+    void completeSend(std::size_t sent);
+
+    bool empty() const;
+    // Bytes queued and not yet sent.
+    std::size_t size() const;
+
+private:
+    static constexpr std::size_t kMaxIov = 64;   // segments per sendmsg
+
+    struct Segment {
+        ChunkPool::Chunk* chunk = nullptr;  // set for pooled chunk segments
+        SharedBuffer shared;                // set for shared segments
+        std::size_t begin = 0;              // read cursor
+        std::size_t end = 0;                // write end (grows for the tail chunk)
+        std::uint32_t tag = kNoTag;         // shared segments only
+        std::uint64_t queued_tsc = 0;       // when its first byte was queued (ServerStats)
+
+        const char* data() const { return chunk ? chunk->data : shared->data(); }
+    };
+
+    // Caller holds mutex_.
+    std::size_t gatherLocked(iovec* iov, std::size_t max, std::size_t& spanned) const;
+    void consume(std::size_t n);
+
+    mutable std::mutex mutex_;
+    std::deque<Segment> segments_;
+    std::size_t bytes_ = 0;
+    std::size_t pinned_ = 0;            // front segments in an asynchronous send
+};
+
+// Slow consumer policy of a connection. Past soft_bytes of unsent data its
+// market data is conflated to the latest state; it is disconnected past
+// hard_bytes, or once it has stayed past soft_bytes for grace_ms (0 = no
+// time limit).
+struct OutboundLimits {
+    std::size_t soft_bytes = 1 << 20;
+    std::size_t hard_bytes = 8 << 20;
+    std::int64_t grace_ms = 5000;
+};
@@ -0,0 +1,497 @@
+#include "Reactor.h"
+
+#include "Client.h"
+#include "LowLatency.h"
+#include "MatchingEngine.h"
+#include "ServerStats.h"
+#include "Tsc.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+
+
+// Outbound tag of the all-symbols market data frames; per-symbol frames
+// are tagged with their SymbolId.
+static constexpr std::uint32_t kAllSymbolsTag = OutboundQueue::kNoTag - 1;
+
+static std::int64_t steadyMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Reactor::Reactor(WorkerPool& pool, MatchingEngine* engine, const OutboundLimits& limits)
+    : pool_(pool), engine_(engine), limits_(limits) {}
+
+Reactor::~Reactor() {
+    // Only blocks at shutdown: a worker may still be in one of their handle()s.
+    for (auto& [fd, client] : retired_) {
+        client.reset();
+        close(fd);
+    }
+    // Close clients
+    for (auto it = clients_.begin(); it != clients_.end(); ) {
+        int fd = it->first;
+        if (epfd_ >= 0) epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+        it = clients_.erase(it);
+        close(fd);
+    }
+    if (timer_fd_ >= 0) { close(timer_fd_); timer_fd_ = -1; }
+    if (listen_fd_ >= 0) { close(listen_fd_); listen_fd_ = -1; }
+    if (wake_fd_ >= 0) { close(wake_fd_); wake_fd_ = -1; }
+    if (epfd_ >= 0) { close(epfd_); epfd_ = -1; }
+}
+
+bool Reactor::init(uint16_t port, bool reuse_port, std::function<void()> on_timer) {
+    // 1) listen socket (non-blocking)
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listen_fd_ < 0) {
+        std::perror("socket");
+        return false;
+    }
+    int yes = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    // every reactor binds the same port; the kernel spreads connections
+    if (reuse_port && setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) < 0) {
+        std::perror("setsockopt SO_REUSEPORT");
+        return false;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);  // 127.0.0.1
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::perror("bind");
+        return false;
+    }
+    if (listen(listen_fd_, SOMAXCONN) < 0) {
+        std::perror("listen");
+        return false;
+    }
+    // find out once whether busy polling is allowed, rather than per accept
+    if (busy_poll_us_ > 0 &&
+        setsockopt(listen_fd_, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us_, sizeof(busy_poll_us_)) < 0) {
+        std::perror("setsockopt SO_BUSY_POLL (not applied to clients)");
+        busy_poll_us_ = 0;
+    }
+
+    // 2) eventfd waking the loop for posted work
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        std::perror("eventfd");
+        return false;
+    }
+
+    // 3) timerfd for periodic tasks (kTimerIntervalMs), only on the reactor driving market data
+    if (on_timer) {
+        on_timer_ = std::move(on_timer);
+        timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timer_fd_ < 0) {
+            std::perror("timerfd_create");
+            return false;
+        }
+        itimerspec its{};
+        its.it_interval.tv_sec = 0;
+        its.it_interval.tv_nsec = kTimerIntervalMs * 1000000;
+        its.it_value = its.it_interval;
+        if (timerfd_settime(timer_fd_, 0, &its, nullptr) < 0) {
+            std::perror("timerfd_settime");
+            return false;
+        }
+    }
+    return initLoop();
+}
+
+bool Reactor::initLoop() {
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd_ < 0) {
+        std::perror("epoll_create1");
+        return false;
+    }
+    for (int fd : {listen_fd_, wake_fd_, timer_fd_}) {
+        if (fd < 0) continue;
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            std::perror("epoll_ctl add");
+            return false;
+        }
+    }
+    return true;
+}
+
+void Reactor::setLowLatency(int busy_poll_us) {
+    spin_ = true;
+    busy_poll_us_ = busy_poll_us;
+}
+
+void Reactor::run() {
+    running_ = true;
+    epoll_event events[1024];
+    while (running_) {
+        // reap whatever the mode; the result only matters to a blocking wait
+        const bool retiring = reapRetired();
+        const int timeout = spin_ ? 0 : retiring ? kReapIntervalMs : -1;
+        int n = epoll_wait(epfd_, events, 1024, timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            uint32_t e = events[i].events;
+
+            if (fd == listen_fd_ && (e & EPOLLIN)) {
+                handleAccept();
+            } else if (fd == timer_fd_ && (e & EPOLLIN)) {
+                handleTimer();
+            } else if (fd == wake_fd_ && (e & EPOLLIN)) {
+                handleMailbox();
+            } else {
+                if (e & (EPOLLHUP | EPOLLERR)) {
+                    closeClient(fd);
+                    continue;
+                }
+                if (e & EPOLLIN) {
+                    handleReadable(fd);
+                }
+                if (e & EPOLLOUT) handleWritable(fd);
+            }
+        }
+    }
+    flushOnStop();
+}
+
+void Reactor::flushOnStop() {
+    if (drain_timeout_ms_ <= 0) return;
+    const std::int64_t deadline = steadyMs() + drain_timeout_ms_;
+    ServerStats& stats = ServerStats::instance();
+    // No more reads: poll() for write space only, whatever epoll still watches.
+    std::vector<pollfd> waiting;
+    for (;;) {
+        waiting.clear();
+        for (auto& [fd, c] : clients_) {
+            if (!c->hasPendingWrite()) continue;
+            const ssize_t sent = c->flushWriteBufferNonBlocking();
+            if (sent < 0) continue;     // peer gone, nothing more will go out
+            stats.addBytesOut(static_cast<size_t>(sent));
+            if (c->hasPendingWrite()) waiting.push_back({fd, POLLOUT, 0});
+        }
+        const std::int64_t left = deadline - steadyMs();
+        if (waiting.empty() || left <= 0) break;
+        poll(waiting.data(), waiting.size(), static_cast<int>(left));
+    }
+}
+
+void Reactor::stop() {
+    running_ = false;
+    std::uint64_t one = 1;
+    if (wake_fd_ >= 0 && write(wake_fd_, &one, sizeof(one)) < 0) {
+        // counter saturated: the loop is already due to wake up
+    }
+}
+
+void Reactor::post(std::function<void()> fn) {
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mailbox_mutex_);
+        wake = mailbox_.empty();
+        mailbox_.push_back(std::move(fn));
+    }
+    if (wake) {
+        std::uint64_t one = 1;
+        if (write(wake_fd_, &one, sizeof(one)) < 0) {
+            // counter saturated: the loop is already due to wake up
+        }
+    }
+}
+
+void Reactor::handleMailbox() {
+    std::uint64_t count;
+    while (read(wake_fd_, &count, sizeof(count)) > 0) {}
+
+    std::vector<std::function<void()>> work;
+    {
+        std::lock_guard<std::mutex> lock(mailbox_mutex_);
+        work.swap(mailbox_);
+    }
+    for (auto& fn : work) fn();
+}
+
+void Reactor::broadcast(const MarketDataFrame& frame) {
+    const std::int64_t now = steadyMs();
+    ServerStats& stats = ServerStats::instance();
+    std::vector<int> slow;
+    for (auto& [fd, c] : clients_) {
+        if (c->protocol() == WireProtocol::Unknown && now - c->acceptedAt() < kProtocolGraceMs) continue;
+        const bool binary = c->protocol() == WireProtocol::Binary;
+        const std::size_t backlog = c->pendingWriteBytes();
+        stats.recordOutboundBacklog(backlog);
+        // Behind by more than the soft limit: replace its unsent market
+        // data with the current state instead of queueing every tick.
+        const bool conflate = engine_ && backlog >= limits_.soft_bytes;
+        if (conflate) stats.countConflation();
+        const SubscriptionSet& subs = c->subscriptions();
+        // The binary frames are only built while handleTimer() counted a
+        // binary client; one detected since then gets the current state.
+        if (subs.all()) {
+            const auto& tick = binary ? frame.binary : frame.json;
+            if (conflate || (!tick && engine_)) {
+                c->replaceInWriteBuffer(kAllSymbolsTag, engine_->marketData().snapshot(binary));
+            } else {
+                c->appendToWriteBuffer(tick, kAllSymbolsTag);
+            }
+        } else {
+            for (const auto& s : frame.symbols) {
+                if (!subs.contains(s.id)) continue;
+                const auto& tick = binary ? s.binary : s.json;
+                if (conflate || !tick) {
+                    c->replaceInWriteBuffer(s.id, engine_->marketData().symbolSnapshot(s.id, binary));
+                } else {
+                    c->appendToWriteBuffer(tick, s.id);
+                }
+            }
+        }
+        if (isSlowConsumer(*c, now)) slow.push_back(fd);
+    }
+    for (int fd : slow) {
+        std::fprintf(stderr, "disconnecting slow consumer fd %d\n", fd);
+        stats.countSlowConsumer();
+        closeClient(fd);
+    }
+}
+
+bool Reactor::isSlowConsumer(Client& client, std::int64_t now_ms) {
+    const std::size_t pending = client.pendingWriteBytes();
+    if (pending >= limits_.hard_bytes) return true;
+    if (pending < limits_.soft_bytes) {
+        client.setOverLimitSince(0);
+        return false;
+    }
+    if (client.overLimitSince() == 0) client.setOverLimitSince(now_ms);
+    return limits_.grace_ms > 0 && now_ms - client.overLimitSince() >= limits_.grace_ms;
+}
+
+void Reactor::handleAccept() {
+    for (;;) {
+        int cfd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (cfd < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            std::perror("accept");
+            break;
+        }
+        epoll_event ce{};
+        ce.events = EPOLLIN; // start with read interest only
+        ce.data.fd = cfd;
+        if (epoll_ctl(epfd_, EPOLL_CTL_ADD, cfd, &ce) < 0) {
+            std::perror("epoll_ctl add client");
+            close(cfd);
+            continue;
+        }
+        addClient(cfd);
+    }
+}
+
+Client* Reactor::addClient(int fd) {
+    if (spin_) lowlatency::tuneSocket(fd, busy_poll_us_);
+    auto cli = std::make_unique<Client>(fd, pool_, read_buffers_);
+    // When client has new data to send, arm write interest on its fd
+    cli->setWritableNotifier([this](int cfd){ this->notifyWritable(cfd); });
+    cli->setResumeNotifier([this](int cfd) { post([this, cfd] { resumeClient(cfd); }); });
+    cli->setMatchingEngine(engine_);
+    cli->setAcceptedAt(steadyMs());
+    Client* client = cli.get();
+    clients_.emplace(fd, std::move(cli));
+    ServerStats::instance().connectionOpened();
+    return client;
+}
+
+void Reactor::scheduleTimer(std::int64_t at_ns) {
+    itimerspec its{};
+    its.it_value.tv_sec = at_ns / 1000000000;
+    its.it_value.tv_nsec = at_ns % 1000000000;
+    if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) its.it_value.tv_nsec = 1;   // 0 disarms
+    if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &its, nullptr) < 0) {
+        std::perror("timerfd_settime");
+    }
+}
+
+void Reactor::handleTimer() {
+    // drain timer ticks
+    std::uint64_t ticks;
+    while (read(timer_fd_, &ticks, sizeof(ticks)) > 0) {}
+
+    if (on_timer_) on_timer_();
+}
+
+void Reactor::handleReadable(int fd) {
+    auto it = clients_.find(fd);
+    if (it == clients_.end()) return;
+    Client* client = it->second.get();
+    // notifyWritable() from a worker re-enables EPOLLIN; still paused
+    if (client->readPaused()) {
+        stopReading(fd, *client);
+        return;
+    }
+    ServerStats& stats = ServerStats::instance();
+    const std::uint64_t started = tsc::now();
+    ReadBuffer& in = client->readBuffer();
+    for (;;) {
+        char* dst = in.prepare(kMinRead);
+        if (!dst) {
+            // a single unfinished frame outgrew the largest buffer
+            closeClient(fd);
+            return;
+        }
+        ssize_t r = read(fd, dst, in.writable());
+        if (r > 0) {
+            in.commit(static_cast<size_t>(r));
+            stats.addBytesIn(static_cast<size_t>(r));
+            if (!parseInput(fd, client)) return;
+            if (client->readPaused()) return;
+        } else if (r == 0) {
+            closeClient(fd);
+            return;
+        } else {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            closeClient(fd);
+            return;
+        }
+    }
+    // nothing left to parse: hand the block back until the next read
+    in.releaseIfEmpty();
+    stats.record(ServerStats::Stage::Read, tsc::now() - started);
+    // If client enqueued response meanwhile, ensure writable is armed
+    // We check at write time; alternatively add hasPendingWrite() and arm here.
+}
+
+bool Reactor::parseInput(int fd, Client* client) {
+    const bool detecting = client->protocol() == WireProtocol::Unknown;
+    while (client->tryParseReadBuffer()) {
+        // messages will be queued and processed on the worker pool
+    }
+    if (detecting && client->protocol() == WireProtocol::Binary) {
+        binary_clients_.fetch_add(1, std::memory_order_relaxed);
+    }
+    // a protocol error, or pipelining requests without reading the responses
+    if (client->hasProtocolError() || client->pendingWriteBytes() >= limits_.hard_bytes) {
+        closeClient(fd);
+        return false;
+    }
+    if (client->readPaused()) stopReading(fd, *client);
+    return true;
+}
+
+void Reactor::stopReading(int fd, Client& client) {
+    epoll_event ev{};
+    ev.events = client.hasPendingWrite() ? EPOLLOUT : 0u;
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev) < 0) {
+        std::perror("epoll_ctl mod stop reading");
+    }
+}
+
+void Reactor::startReading(int fd, Client& client) {
+    epoll_event ev{};
+    ev.events = EPOLLIN | (client.hasPendingWrite() ? EPOLLOUT : 0u);
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev) < 0) {
+        std::perror("epoll_ctl mod start reading");
+    }
+}
+
+void Reactor::resumeClient(int fd) {
+    // the notice may be stale: the client is gone, or its fd reused
+    auto it = clients_.find(fd);
+    if (it == clients_.end()) return;
+    Client* client = it->second.get();
+    if (!client->readPaused() || !client->retryStalled()) return;
+    // what was already read first, then the socket again
+    if (!parseInput(fd, client)) return;
+    if (!client->readPaused()) startReading(fd, *client);
+}
+
+void Reactor::handleWritable(int fd) {
+    auto it = clients_.find(fd);
+    if (it == clients_.end()) return;
+    Client* client = it->second.get();
+    // Ask client to flush its buffered data
+    const ssize_t sent = client->flushWriteBufferNonBlocking();
+    if (sent < 0) {
+        closeClient(fd);
+        return;
+    }
+    ServerStats::instance().addBytesOut(static_cast<size_t>(sent));
+    // Socket full: keep EPOLLOUT and wait for the next writable event.
+    if (client->hasPendingWrite()) return;
+
+    // Drained: back to EPOLLIN only (nothing while paused). A producer that
+    // appended after the flush either re-armed before this MOD (caught by
+    // the re-check below) or will see the empty -> non-empty transition
+    // and re-arm after it.
+    epoll_event ev{};
+    ev.events = client->readPaused() ? 0u : EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev) < 0) {
+        std::perror("epoll_ctl mod clear EPOLLOUT");
+    }
+    if (client->hasPendingWrite()) notifyWritable(fd);
+}
+
+void Reactor::closeClient(int fd) {
+    auto it = clients_.find(fd);
+    if (it == clients_.end()) return;
+    if (it->second->protocol() == WireProtocol::Binary) {
+        binary_clients_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+    std::unique_ptr<Client> client = std::move(it->second);
+    clients_.erase(it);
+    client->retire();
+    reclaim(fd, std::move(client));
+    ServerStats::instance().connectionClosed();
+}
+
+void Reactor::reclaim(int fd, std::unique_ptr<Client> client) {
+    if (!client->idle()) {
+        retired_.emplace_back(fd, std::move(client));
+        return;
+    }
+    // Destroy first: the fd number is only reused once nothing can
+    // notify or write through it any more.
+    client.reset();
+    close(fd);
+}
+
+bool Reactor::reapRetired() {
+    std::erase_if(retired_, [](auto& r) {
+        if (!r.second->idle()) return false;
+        r.second.reset();
+        close(r.first);
+        return true;
+    });
+    return !retired_.empty();
+}
+
+void Reactor::notifyWritable(int fd) {
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.fd = fd;
+    // ENOENT: a retired client's worker answered its last message
+    if (epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev) < 0 && errno != ENOENT) {
+        std::perror("epoll_ctl mod writable");
+    }
+}
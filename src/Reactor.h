@@ -0,0 +1,159 @@
+// Reactor.h
+// One epoll event loop of TradeServer. Each reactor owns its epoll fd,
+// its listening socket (SO_REUSEPORT when the server is sharded), its
+// client map and a mailbox for work posted from other threads. Clients
+// are only ever touched by the reactor that accepted them, so the client
+// map needs no lock.
+//
+// The socket I/O is the only epoll-specific part: UringReactor overrides
+// initLoop(), run(), notifyWritable() and closeClient() and shares the
+// rest (clients, parsing, market data fan-out, timer, mailbox).
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "MarketDataGenerator.h"
+#include "OutboundQueue.h"
+#include "ReadBuffer.h"
+
+class Client;                // forward declaration (defined in Client.h)
+class MatchingEngine;        // forward declaration (defined in MatchingEngine.h)
+class WorkerPool;            // forward declaration (defined in WorkerPool.h)
+
+// One market data tick, encoded once and shared by every reactor and
+// client; clients queue references to these buffers, never copies.
+struct MarketDataFrame {
+    std::shared_ptr<const std::string> json;
+    std::shared_ptr<const std::string> binary;  // null when no client speaks binary
+    // The same tick split per symbol; only built while some client
+    // subscribes to a subset of the symbols.
+    std::vector<MarketDataGenerator::SymbolFrame> symbols;
+};
+
+class Reactor {
+public:
+    // Period of the market data timer.
+    static constexpr std::int64_t kTimerIntervalMs = 250;
+    // A client that has not sent its first frame yet gets no market data
+    // this long after accept, then JSON: a binary client's first frame
+    // must not race a JSON tick.
+    static constexpr std::int64_t kProtocolGraceMs = kTimerIntervalMs;
+
+    Reactor(WorkerPool& pool, MatchingEngine* engine, const OutboundLimits& limits = {});
+    virtual ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    // Create the listening socket, the mailbox eventfd and, when on_timer
+    // is set, the periodic timer; then the event loop. Return true on success.
+    bool init(uint16_t port, bool reuse_port, std::function<void()> on_timer);
+
+    // Low-latency mode, before init(): the loop polls without ever
+    // blocking, and accepted sockets get TCP_NODELAY and SO_BUSY_POLL of
+    // busy_poll_us (0 = not set).
+    void setLowLatency(int busy_poll_us);
+
+    // Before init(): on stop(), keep sending the data already queued to
+    // clients for up to ms (0 = exit right away).
+    void setDrainTimeout(std::int64_t ms) { drain_timeout_ms_ = ms; }
+
+    // Blocking event loop; returns after stop() and the outbound drain.
+    virtual void run();
+
+    // Thread-safe (and async-signal-safe): ask the loop to exit.
+    void stop();
+
+    // Thread-safe: run fn on this reactor's thread.
+    void post(std::function<void()> fn);
+
+    // Reactor thread only: queue a market data tick to every client, for
+    // the symbols it subscribes to. Clients past the soft outbound limit
+    // get it conflated, slow consumers are disconnected.
+    void broadcast(const MarketDataFrame& frame);
+
+    // Replace the periodic timer with a one-shot at steady_clock time
+    // at_ns (CLOCK_MONOTONIC); a time already past fires right away.
+    // Only on the reactor created with on_timer.
+    void scheduleTimer(std::int64_t at_ns);
+
+    // Thread-safe: arm EPOLLOUT when there is pending data.
+    virtual void notifyWritable(int fd);
+
+    // Number of clients that selected the binary protocol (any thread).
+    size_t binaryClients() const { return binary_clients_.load(std::memory_order_relaxed); }
+
+protected:
+    // Free space guaranteed to each read() call.
+    static constexpr size_t kMinRead = 2048;
+    // While closed clients wait for their worker, the loop wakes up this
+    // often to reclaim them.
+    static constexpr int kReapIntervalMs = 1;
+
+    // epoll fd with the listening socket, eventfd and timerfd registered.
+    virtual bool initLoop();
+    // Take ownership of an accepted connection.
+    Client* addClient(int fd);
+    // Parse the client's read buffer after new bytes came in; false if the
+    // client had to be closed. Stops reading from it when its message
+    // queue is full.
+    bool parseInput(int fd, Client* client);
+    // Stop / restart reading from a client whose queue was full
+    // (Client::readPaused()); the socket keeps its write interest.
+    virtual void stopReading(int fd, Client& client);
+    virtual void startReading(int fd, Client& client);
+    // Posted by the client's drain once its queue has room again.
+    void resumeClient(int fd);
+
+    void handleAccept();
+    void handleTimer();
+    void handleMailbox();
+    void handleReadable(int fd);
+    void handleWritable(int fd);
+    virtual void closeClient(int fd);
+    // Destroy a retired client and close its fd, or, while a worker still
+    // handles one of its messages, park it until reapRetired() finds it idle.
+    void reclaim(int fd, std::unique_ptr<Client> client);
+    // True if clients are still waiting for their worker.
+    bool reapRetired();
+    // After the loop: send what is queued until done or the drain timeout.
+    virtual void flushOnStop();
+    // Apply OutboundLimits; true if the client must be disconnected.
+    bool isSlowConsumer(Client& client, std::int64_t now_ms);
+
+    WorkerPool& pool_;
+    MatchingEngine* engine_;
+    OutboundLimits limits_;
+    std::function<void()> on_timer_{};
+
+    int epfd_{-1};
+    int listen_fd_{-1};
+    int timer_fd_{-1};
+    int wake_fd_{-1};       // eventfd signalled by post()/stop()
+    std::atomic<bool> running_{false};
+    std::atomic<size_t> binary_clients_{0};
+    bool spin_{false};
+    int busy_poll_us_{0};
+    std::int64_t drain_timeout_ms_{0};
+
+    std::mutex mailbox_mutex_;
+    std::vector<std::function<void()>> mailbox_;
+
+    // Read buffers of this reactor's clients; declared before clients_ so
+    // it outlives them.
+    BufferPool read_buffers_;
+
+    // Clients accepted by this reactor, keyed by fd.
+    std::unordered_map<int, std::unique_ptr<Client>> clients_;
+    // Closed clients a worker is still handling a message of, with their fd.
+    std::vector<std::pair<int, std::unique_ptr<Client>>> retired_;
+};
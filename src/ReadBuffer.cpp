@@ -0,0 +1,72 @@
+#include "ReadBuffer.h"
+
+#include <cstring>
+
+BufferPool::~BufferPool() {
+    for (auto& list : free_) {
+        for (char* block : list) delete[] block;
+    }
+}
+
+std::size_t BufferPool::classOf(std::size_t size) {
+    std::size_t cls = 0;
+    std::size_t cap = kMinBlock;
+    while (cap < size) {
+        cap <<= 1;
+        ++cls;
+    }
+    return cls;
+}
+
+char* BufferPool::acquire(std::size_t size, std::size_t& capacity) {
+    std::size_t cls = classOf(size);
+    capacity = kMinBlock << cls;
+    auto& list = free_[cls];
+    if (!list.empty()) {
+        char* block = list.back();
+        list.pop_back();
+        return block;
+    }
+    return new char[capacity];
+}
+
+void BufferPool::release(char* block, std::size_t capacity) {
+    auto& list = free_[classOf(capacity)];
+    if ((list.size() + 1) * capacity <= kMaxCachedBytes) {
+        list.push_back(block);
+    } else {
+        delete[] block;
+    }
+}
+
+char* ReadBuffer::prepare(std::size_t min) {
+    if (writable() >= min) return block_ + end_;
+
+    const std::size_t used = size();
+    if (used + min > BufferPool::kMaxBlock) return nullptr;
+    if (block_ && used + min <= capacity_) {
+        // enough room once the parsed prefix is dropped
+        std::memmove(block_, block_ + begin_, used);
+    } else {
+        std::size_t capacity;
+        char* bigger = pool_.acquire(used + min, capacity);
+        if (used > 0) std::memcpy(bigger, block_ + begin_, used);
+        if (block_) pool_.release(block_, capacity_);
+        block_ = bigger;
+        capacity_ = capacity;
+    }
+    begin_ = 0;
+    end_ = used;
+    return block_ + end_;
+}
+
+void ReadBuffer::consume(std::size_t n) {
+    begin_ += n;
+    if (begin_ == end_) begin_ = end_ = 0;
+}
+
+void ReadBuffer::release() {
+    if (block_) pool_.release(block_, capacity_);
+    block_ = nullptr;
+    capacity_ = begin_ = end_ = 0;
+}
@@ -0,0 +1,78 @@
+// ReadBuffer.h
+// Inbound side of a connection. The reactor reads straight into a
+// ReadBuffer and the parser works on the bytes in place; nothing is copied
+// between the socket and the framer.
+//
+// Storage comes from a BufferPool of power-of-two size classes owned by
+// the reactor, so it needs no lock. A buffer only holds a block while it
+// has unparsed bytes: once drained it goes back to the pool, so thousands
+// of idle connections hold no memory and the next reader reuses a block
+// that is still hot in cache.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+class BufferPool {
+public:
+    static constexpr std::size_t kMinBlock = 4 * 1024;
+    static constexpr std::size_t kMaxBlock = 2 * 1024 * 1024;   // > largest binary frame
+    static constexpr std::size_t kClassCount = 10;              // 4 KiB .. 2 MiB
+    static constexpr std::size_t kMaxCachedBytes = 4 * 1024 * 1024;  // per size class
+
+    BufferPool() = default;
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Return a block of at least `size` bytes (rounded up to its class).
+    // `size` must not exceed kMaxBlock.
+    char* acquire(std::size_t size, std::size_t& capacity);
+    void release(char* block, std::size_t capacity);
+
+private:
+    static std::size_t classOf(std::size_t size);
+
+    std::array<std::vector<char*>, kClassCount> free_{};
+};
+
+class ReadBuffer {
+public:
+    explicit ReadBuffer(BufferPool& pool) : pool_(pool) {}
+    ~ReadBuffer() { release(); }
+
+    ReadBuffer(const ReadBuffer&) = delete;
+    ReadBuffer& operator=(const ReadBuffer&) = delete;
+
+    // Make room for at least `min` more bytes (compacting or moving to a
+    // larger block) and return where to read into; writable() tells how much.
+    // Returns nullptr if the buffered data would exceed BufferPool::kMaxBlock.
+    char* prepare(std::size_t min);
+    std::size_t writable() const { return capacity_ - end_; }
+    // The last read stored n bytes at prepare().
+    void commit(std::size_t n) { end_ += n; }
+
+    // Unparsed bytes.
+    std::string_view data() const { return {block_ + begin_, end_ - begin_}; }
+    std::size_t size() const { return end_ - begin_; }
+    bool empty() const { return begin_ == end_; }
+
+    // Drop n parsed bytes from the front.
+    void consume(std::size_t n);
+    void clear() { begin_ = end_ = 0; }
+
+    // Hand the block back to the pool if no unparsed bytes remain.
+    void releaseIfEmpty() { if (empty()) release(); }
+    void release();
+
+private:
+    BufferPool& pool_;
+    char* block_ = nullptr;
+    std::size_t capacity_ = 0;
+    std::size_t begin_ = 0;     // first unparsed byte
+    std::size_t end_ = 0;       // end of received data
+};
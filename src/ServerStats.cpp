@@ -0,0 +1,123 @@
+#include "ServerStats.h"
+
+#include "Tsc.h"
+#include "WorkerPool.h"
+
+#include <chrono>
+
+static std::int64_t steadyMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Latency histogram in ns; ticks are converted with the current tick rate.
+static json latencyJson(const Histogram& h, double ns_per_tick) {
+    auto ns = [ns_per_tick](std::uint64_t ticks) {
+        return static_cast<std::uint64_t>(static_cast<double>(ticks) * ns_per_tick);
+    };
+    const std::uint64_t count = h.count();
+    json j;
+    j["count"] = count;
+    j["mean"] = count ? ns(h.sum() / count) : 0;
+    j["p50"] = ns(h.percentile(0.50));
+    j["p90"] = ns(h.percentile(0.90));
+    j["p99"] = ns(h.percentile(0.99));
+    j["p999"] = ns(h.percentile(0.999));
+    j["max"] = ns(h.max());
+    return j;
+}
+
+// Histogram of plain values (depths, bytes).
+static json valueJson(const Histogram& h) {
+    const std::uint64_t count = h.count();
+    json j;
+    j["count"] = count;
+    j["mean"] = count ? h.sum() / count : 0;
+    j["p50"] = h.percentile(0.50);
+    j["p99"] = h.percentile(0.99);
+    j["max"] = h.max();
+    return j;
+}
+
+ServerStats& ServerStats::instance() {
+    static ServerStats stats;
+    return stats;
+}
+
+ServerStats::ServerStats() : started_ms_(steadyMs()) {
+    last_roll_ms_ = started_ms_;
+}
+
+std::uint64_t ServerStats::messagesHandled() const {
+    std::uint64_t n = 0;
+    for (const Histogram& h : handle_) n += h.count();
+    return n;
+}
+
+void ServerStats::roll(std::int64_t now_ms) {
+    const std::int64_t span = now_ms - last_roll_ms_;
+    if (span < 1000) return;
+    const std::uint64_t messages = messagesHandled();
+    const std::uint64_t in = bytes_in_.load(std::memory_order_relaxed);
+    const std::uint64_t out = bytes_out_.load(std::memory_order_relaxed);
+    auto perSec = [span](std::uint64_t delta) { return delta * 1000 / static_cast<std::uint64_t>(span); };
+    messages_per_sec_.store(perSec(messages - last_messages_), std::memory_order_relaxed);
+    bytes_in_per_sec_.store(perSec(in - last_bytes_in_), std::memory_order_relaxed);
+    bytes_out_per_sec_.store(perSec(out - last_bytes_out_), std::memory_order_relaxed);
+    last_messages_ = messages;
+    last_bytes_in_ = in;
+    last_bytes_out_ = out;
+    last_roll_ms_ = now_ms;
+}
+
+json ServerStats::toJson() const {
+    const double ns_per_tick = tsc::nanosPerTick();
+    json j;
+    j["uptime_ms"] = steadyMs() - started_ms_;
+
+    json latency;
+    latency["read"] = latencyJson(stages_[static_cast<std::size_t>(Stage::Read)], ns_per_tick);
+    latency["parse"] = latencyJson(stages_[static_cast<std::size_t>(Stage::Parse)], ns_per_tick);
+    latency["queue_wait"] = latencyJson(stages_[static_cast<std::size_t>(Stage::QueueWait)], ns_per_tick);
+    latency["request"] = latencyJson(stages_[static_cast<std::size_t>(Stage::Request)], ns_per_tick);
+    latency["outbound_wait"] = latencyJson(stages_[static_cast<std::size_t>(Stage::OutboundWait)], ns_per_tick);
+    json handle;
+    json messages;
+#define X(msg_type, msg_str) \
+    handle[msg_str] = latencyJson(handle_[static_cast<std::size_t>(MessageType::msg_type)], ns_per_tick); \
+    messages[msg_str] = handle_[static_cast<std::size_t>(MessageType::msg_type)].count();
+    MESSAGE_TYPE_LIST
+#undef X
+    latency["handle"] = std::move(handle);
+    j["latency_ns"] = std::move(latency);
+
+    const WorkerPool* pool = pool_.load(std::memory_order_acquire);
+    json queues;
+    queues["messages_queued"] = queued_.load(std::memory_order_relaxed);
+    queues["depth_at_enqueue"] = valueJson(queue_depth_);
+    queues["worker_tasks"] = pool ? pool->queued() : 0;
+    queues["read_pauses"] = read_pauses_.load(std::memory_order_relaxed);
+    j["queues"] = std::move(queues);
+
+    json outbound;
+    outbound["backlog_bytes_per_client"] = valueJson(outbound_backlog_);
+    outbound["conflations"] = conflations_.load(std::memory_order_relaxed);
+    outbound["slow_consumer_disconnects"] = slow_consumers_.load(std::memory_order_relaxed);
+    j["outbound"] = std::move(outbound);
+
+    const std::uint64_t accepted = accepted_.load(std::memory_order_relaxed);
+    json counters;
+    counters["connections_accepted"] = accepted;
+    counters["connections_open"] = accepted - closed_.load(std::memory_order_relaxed);
+    counters["messages"] = std::move(messages);
+    counters["bytes_in"] = bytes_in_.load(std::memory_order_relaxed);
+    counters["bytes_out"] = bytes_out_.load(std::memory_order_relaxed);
+    j["counters"] = std::move(counters);
+
+    json rates;
+    rates["messages_per_sec"] = messages_per_sec_.load(std::memory_order_relaxed);
+    rates["bytes_in_per_sec"] = bytes_in_per_sec_.load(std::memory_order_relaxed);
+    rates["bytes_out_per_sec"] = bytes_out_per_sec_.load(std::memory_order_relaxed);
+    j["rates"] = std::move(rates);
+    return j;
+}
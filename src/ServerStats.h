@@ -0,0 +1,92 @@
+// ServerStats.h
+// Process-wide instrumentation of the request path, answered by the
+// `stats` message. Stage latencies are Histograms of TSC tick deltas
+// (reported in ns), each recorded where its stage ends:
+//
+//   read           Reactor::handleReadable, one readable event: read() + parse
+//   parse          one frame, read buffer -> Message
+//   queue_wait     Client::enqueue -> a worker picks it up (message_queue_ + pool)
+//   handle         Message::handle(), per message type
+//   request        frame parsed -> response queued for sending
+//   outbound_wait  an outbound segment, queued -> fully sent
+//
+// plus the per-client message queue depth at each enqueue, each client's
+// outbound backlog at every market data tick, and byte / message counters
+// with rates over the last second. Everything is relaxed atomics, so any
+// thread records without locking.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "Histogram.h"
+#include "Message.h"
+
+class WorkerPool;   // forward declaration (defined in WorkerPool.h)
+
+class ServerStats {
+public:
+    enum class Stage { Read, Parse, QueueWait, Request, OutboundWait, Count };
+
+    static ServerStats& instance();
+
+    void record(Stage stage, std::uint64_t ticks) { stages_[static_cast<std::size_t>(stage)].record(ticks); }
+    // Also counts the message.
+    void recordHandle(MessageType type, std::uint64_t ticks) { handle_[static_cast<std::size_t>(type)].record(ticks); }
+    void recordQueueDepth(std::size_t depth) { queue_depth_.record(depth); }
+    void recordOutboundBacklog(std::size_t bytes) { outbound_backlog_.record(bytes); }
+
+    void messageQueued() { queued_.fetch_add(1, std::memory_order_relaxed); }
+    void messageDone(std::size_t n = 1) { queued_.fetch_sub(static_cast<std::int64_t>(n), std::memory_order_relaxed); }
+    void addBytesIn(std::size_t n) { bytes_in_.fetch_add(n, std::memory_order_relaxed); }
+    void addBytesOut(std::size_t n) { bytes_out_.fetch_add(n, std::memory_order_relaxed); }
+    void connectionOpened() { accepted_.fetch_add(1, std::memory_order_relaxed); }
+    void connectionClosed() { closed_.fetch_add(1, std::memory_order_relaxed); }
+    void countConflation() { conflations_.fetch_add(1, std::memory_order_relaxed); }
+    void countSlowConsumer() { slow_consumers_.fetch_add(1, std::memory_order_relaxed); }
+    // A client's message queue was full and its reads were paused.
+    void countReadPause() { read_pauses_.fetch_add(1, std::memory_order_relaxed); }
+
+    // Pool whose task backlog is reported; null to detach.
+    void setWorkerPool(const WorkerPool* pool) { pool_.store(pool, std::memory_order_release); }
+
+    // Single caller (the market data timer), about once a second: close the
+    // window the per-second rates are computed over.
+    void roll(std::int64_t now_ms);
+
+    // Everything above as one JSON object, latencies in ns.
+    json toJson() const;
+
+private:
+    ServerStats();
+
+    std::uint64_t messagesHandled() const;
+
+    Histogram stages_[static_cast<std::size_t>(Stage::Count)];
+    Histogram handle_[kMessageTypeCount];
+    Histogram queue_depth_;
+    Histogram outbound_backlog_;
+
+    std::atomic<std::int64_t> queued_{0};   // messages parsed and not yet handled
+    std::atomic<std::uint64_t> bytes_in_{0};
+    std::atomic<std::uint64_t> bytes_out_{0};
+    std::atomic<std::uint64_t> accepted_{0};
+    std::atomic<std::uint64_t> closed_{0};
+    std::atomic<std::uint64_t> conflations_{0};
+    std::atomic<std::uint64_t> slow_consumers_{0};
+    std::atomic<std::uint64_t> read_pauses_{0};
+    std::atomic<const WorkerPool*> pool_{nullptr};
+
+    const std::int64_t started_ms_;
+
+    // Rate window; only roll() touches the last_* fields.
+    std::int64_t last_roll_ms_ = 0;
+    std::uint64_t last_messages_ = 0;
+    std::uint64_t last_bytes_in_ = 0;
+    std::uint64_t last_bytes_out_ = 0;
+    std::atomic<std::uint64_t> messages_per_sec_{0};
+    std::atomic<std::uint64_t> bytes_in_per_sec_{0};
+    std::atomic<std::uint64_t> bytes_out_per_sec_{0};
+};
@@ -0,0 +1,24 @@
+#include "SnapshotMessage.h"
+#include "MessagePool.h"
+#include "Client.h"
+#include "MatchingEngine.h"
+
+
+SnapshotMessage::SnapshotMessage(MessageType type_, json) : Message(type_) {}
+
+MessagePtr SnapshotMessage::fromBinary(MessageType type_, std::string_view payload, MessagePool& pool) {
+    if (!payload.empty()) return nullptr;
+    return pool.create<SnapshotMessage>(type_);
+}
+
+const json& SnapshotMessage::handle(Client& client) {
+    MatchingEngine* engine = client.matchingEngine();
+    if (engine) {
+        client.sendSnapshot();
+        status_code_ = 200;
+    } else {
+        status_code_ = 503;
+    }
+    toJson();
+    return data_;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Message.h"
+
+#include <string_view>
+
+// Client-initiated market data recovery: queue a snapshot of the subscribed
+// books (in the connection's protocol) ahead of the status response.
+class SnapshotMessage : public Message {
+    explicit SnapshotMessage(MessageType type_) : Message(type_) {}
+    friend class MessagePool;
+public:
+    SnapshotMessage(MessageType type_, json j);
+    // Payload is empty.
+    static MessagePtr fromBinary(MessageType type_, std::string_view payload, MessagePool& pool);
+    const json& handle(Client& client) override;
+};
@@ -0,0 +1,25 @@
+#include "StatsMessage.h"
+#include "MessagePool.h"
+#include "ServerStats.h"
+
+
+StatsMessage::StatsMessage(MessageType type_, json) : Message(type_) {}
+
+MessagePtr StatsMessage::fromBinary(MessageType type_, std::string_view payload, MessagePool& pool) {
+    if (!payload.empty()) return nullptr;
+    return pool.create<StatsMessage>(type_);
+}
+
+const json& StatsMessage::handle(Client&) {
+    status_code_ = 200;
+    toJson();
+    data_["stats"] = ServerStats::instance().toJson();
+    return data_;
+}
+
+void StatsMessage::toBinary(std::string& out) const {
+    std::size_t at = wire::beginFrame(out, static_cast<std::uint16_t>(getType()), seq_);
+    wire::appendPod(out, wire::StatusResponse{status_code_});
+    out += data_["stats"].dump();
+    wire::endFrame(out, at);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Message.h"
+
+#include <string_view>
+
+// Admin query: the ServerStats snapshot (stage latency histograms, queue
+// depths, outbound backlog, counters and rates) under "stats". Binary
+// responses carry it as JSON text after the status.
+class StatsMessage : public Message {
+    explicit StatsMessage(MessageType type_) : Message(type_) {}
+    friend class MessagePool;
+public:
+    StatsMessage(MessageType type_, json j);
+    // Payload is empty.
+    static MessagePtr fromBinary(MessageType type_, std::string_view payload, MessagePool& pool);
+    const json& handle(Client& client) override;
+    void toBinary(std::string& out) const override;
+};
@@ -0,0 +1,9 @@
+#include "SubscribeMessage.h"
+#include "MessagePool.h"
+
+
+MessagePtr SubscribeMessage::fromBinary(MessageType type_, std::string_view payload, MessagePool& pool) {
+    MessagePtr out = pool.create<SubscribeMessage>(type_);
+    if (!static_cast<SubscribeMessage*>(out.get())->decode(payload)) return nullptr;
+    return out;
+}
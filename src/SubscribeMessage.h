@@ -0,0 +1,17 @@
+#pragma once
+
+#include "SubscriptionMessage.h"
+
+#include <string_view>
+
+// Start receiving market data for the listed symbols. The first subscribe
+// replaces the default of every symbol; each newly added book is preceded
+// by its snapshot.
+class SubscribeMessage : public SubscriptionMessage {
+    explicit SubscribeMessage(MessageType type_) : SubscriptionMessage(type_) {}
+    friend class MessagePool;
+public:
+    SubscribeMessage(MessageType type_, json j) : SubscriptionMessage(type_, std::move(j)) {}
+    // Decode a wire::SubscriptionRequest payload; nullptr if malformed.
+    static MessagePtr fromBinary(MessageType type_, std::string_view payload, MessagePool& pool);
+};
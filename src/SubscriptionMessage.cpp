@@ -0,0 +1,57 @@
+#include "SubscriptionMessage.h"
+#include "Client.h"
+
+#include <cstring>
+
+
+SubscriptionMessage::SubscriptionMessage(MessageType type_, json j) : Message(type_) {
+    auto it = j.find("symbols");
+    if (it == j.end() || !it->is_array()) {
+        valid_ = false;
+        return;
+    }
+    symbols.reserve(it->size());
+    for (const auto& s : *it) {
+        symbols.push_back(s.get<std::string>());
+    }
+}
+
+bool SubscriptionMessage::decode(std::string_view payload) {
+    wire::SubscriptionRequest req;
+    if (payload.size() < sizeof(req)) return false;
+    std::memcpy(&req, payload.data(), sizeof(req));
+    payload.remove_prefix(sizeof(req));
+    constexpr std::size_t kNameSize = 8;
+    if (payload.size() != req.symbol_count * kNameSize) return false;
+    symbols.reserve(req.symbol_count);
+    for (std::size_t i = 0; i < req.symbol_count; ++i) {
+        symbols.emplace_back(wire::fixedString(payload.data() + i * kNameSize, kNameSize));
+    }
+    return true;
+}
+
+const json& SubscriptionMessage::handle(Client& client) {
+    if (!valid_) {
+        status_code_ = 400;
+    } else if (!client.matchingEngine()) {
+        status_code_ = 503;
+    } else {
+        const bool add = getType() == MessageType::Subscribe;
+        for (const auto& s : symbols) {
+            if (!(add ? client.subscribe(s) : client.unsubscribe(s))) unknown_.push_back(s);
+        }
+        status_code_ = unknown_.empty() ? 200 : 404;
+    }
+    toJson();
+    return data_;
+}
+
+void SubscriptionMessage::toJson() {
+    Message::toJson();
+    if (!valid_) {
+        data_["error"] = "Malformed subscription request";
+    } else if (!unknown_.empty()) {
+        data_["error"] = "Unknown symbol";
+        data_["unknown"] = unknown_;
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Message.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Common handling of subscribe/unsubscribe requests: a list of symbol
+// names, "*" meaning every symbol. Unknown names are reported back (404)
+// while the known ones still take effect.
+class SubscriptionMessage : public Message {
+protected:
+    std::vector<std::string> symbols;
+    std::vector<std::string> unknown_;
+    bool valid_ = true;
+
+    SubscriptionMessage(MessageType type_) : Message(type_) {}
+    SubscriptionMessage(MessageType type_, json j);
+
+    // Decode a wire::SubscriptionRequest payload into symbols; false if malformed.
+    bool decode(std::string_view payload);
+public:
+    const json& handle(Client& client) override;
+    void toJson() override;
+};
@@ -0,0 +1,64 @@
+// SubscriptionSet.h
+// Symbols a client receives market data for: either every symbol (the
+// default) or an explicit set kept as a bitmap over symbol ids.
+//
+// Changed by the client's message handlers (one at a time), read by its
+// reactor on every broadcast, so all state is atomic; a change shows up
+// from the next tick on.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class SubscriptionSet {
+public:
+    // Size the bitmap for a universe of `symbols` ids. Call before use.
+    void resize(std::size_t symbols) {
+        words_count_ = (symbols + 63) / 64;
+        words_ = std::make_unique<std::atomic<std::uint64_t>[]>(words_count_);
+    }
+
+    bool all() const { return all_.load(std::memory_order_acquire); }
+
+    bool contains(std::uint32_t id) const {
+        if (all()) return true;
+        std::size_t w = id / 64;
+        return w < words_count_ &&
+               (words_[w].load(std::memory_order_relaxed) >> (id % 64) & 1) != 0;
+    }
+
+    void setAll() { all_.store(true, std::memory_order_release); }
+
+    // Switch to an explicit set that starts out empty (or full, so that
+    // unsubscribing from "everything" leaves the rest).
+    void makeExplicit(bool full) {
+        if (!all()) return;
+        for (std::size_t w = 0; w < words_count_; ++w) {
+            words_[w].store(full ? ~std::uint64_t{0} : 0, std::memory_order_relaxed);
+        }
+        all_.store(false, std::memory_order_release);
+    }
+
+    void clear() {
+        for (std::size_t w = 0; w < words_count_; ++w) words_[w].store(0, std::memory_order_relaxed);
+        all_.store(false, std::memory_order_release);
+    }
+
+    void add(std::uint32_t id) {
+        std::size_t w = id / 64;
+        if (w < words_count_) words_[w].fetch_or(std::uint64_t{1} << (id % 64), std::memory_order_relaxed);
+    }
+
+    void remove(std::uint32_t id) {
+        std::size_t w = id / 64;
+        if (w < words_count_) words_[w].fetch_and(~(std::uint64_t{1} << (id % 64)), std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<bool> all_{true};
+    std::unique_ptr<std::atomic<std::uint64_t>[]> words_;
+    std::size_t words_count_ = 0;
+};
@@ -39,6 +39,14 @@ public:
         return true;
     }
 
+    bool try_pop(T& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.empty()) return false;
+        value = std::move(queue_.front());
+        queue_.pop();
+        return true;
+    }
+
     void close() {
         std::lock_guard<std::mutex> lock(mutex_);
         closed_ = true;
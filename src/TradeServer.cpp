@@ -1,234 +1,261 @@
 #include "TradeServer.h"
 
-#include "Client.h"
+#include "EngineShards.h"
+#include "LowLatency.h"
 #include "MarketDataGenerator.h"
+#include "MatchingEngine.h"
+#include "OrderLog.h"
+#include "Reactor.h"
+#include "ServerStats.h"
+#include "Tsc.h"
+#include "UringReactor.h"
+#include "WorkerPool.h"
 
-#include <arpa/inet.h>
-#include <fcntl.h>
-#include <netinet/in.h>
-#include <sys/epoll.h>
-#include <sys/socket.h>
-#include <sys/timerfd.h>
-#include <unistd.h>
-
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 
+static std::int64_t steadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// config.cpus[from, from + count), or what of it there is.
+static std::vector<int> cpuSlice(const ServerConfig& config, std::size_t from, std::size_t count) {
+    if (config.cpus.size() <= from) return {};
+    const std::size_t end = std::min(config.cpus.size(), from + count);
+    return {config.cpus.begin() + static_cast<std::ptrdiff_t>(from),
+            config.cpus.begin() + static_cast<std::ptrdiff_t>(end)};
+}
+
+// The workers' share of config.cpus, after the reactors' and engine threads'.
+static std::vector<int> workerCpus(const ServerConfig& config) {
+    const std::size_t reactors = std::max<std::size_t>(config.reactors, 1);
+    return cpuSlice(config, reactors + config.engine_threads, config.cpus.size());
+}
+
+TradeServer::TradeServer(const ServerConfig& config)
+    : config_(config),
+      pool_(std::make_unique<WorkerPool>(config.worker_threads, config.low_latency, workerCpus(config))) {
+    if (config_.reactors == 0) config_.reactors = 1;
+}
 
-TradeServer::TradeServer(uint16_t port) : port_(port) {}
+TradeServer::TradeServer(uint16_t port) : TradeServer(ServerConfig{port}) {}
 
-TradeServer::~TradeServer() { stop(); }
+TradeServer::~TradeServer() {
+    ServerStats::instance().setWorkerPool(nullptr);
+    stop();
+    for (auto& t : threads_) {
+        if (t.joinable()) t.join();
+    }
+    reactors_.clear();
+}
 
 void TradeServer::setMarketDataGenerator(std::unique_ptr<MarketDataGenerator> mdg) {
+    engine_.reset();
     mdg_ = std::move(mdg);
+    if (mdg_) {
+        mdg_->setWorkerPool(pool_.get());
+        engine_ = std::make_unique<MatchingEngine>(*mdg_);
+    }
 }
 
 bool TradeServer::init() {
-    epfd_ = epoll_create1(EPOLL_CLOEXEC);
-    if (epfd_ < 0) {
-        std::perror("epoll_create1");
+    if (config_.simulated && !config_.replay.empty()) {
+        std::cerr << "simulated time and replay are exclusive\n";
         return false;
     }
-
-    // 1) listen socket (non-blocking)
-    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
-    if (listen_fd_ < 0) {
-        std::perror("socket");
-        return false;
+    if (!initJournal()) return false;
+    if (!initOrderLog()) return false;
+    // Locked from here on: what init() allocates next is resident already.
+    // Not fatal, the server is only slower to warm up.
+    if (config_.low_latency) lowlatency::lockMemory();
+    if (config_.simulated && mdg_) mdg_->setClock([this] { return sim_now_ms_; });
+    if (config_.engine_threads > 0 && mdg_) {
+        shards_ = std::make_unique<EngineShards>(config_.engine_threads, config_.low_latency,
+                                                 cpuSlice(config_, config_.reactors, config_.engine_threads));
+        mdg_->setShards(shards_.get());
+    }
+    const bool sharded = config_.reactors > 1;
+    for (size_t i = 0; i < config_.reactors; ++i) {
+        std::unique_ptr<Reactor> reactor;
+        if (config_.io_uring) {
+            reactor = std::make_unique<UringReactor>(*pool_, engine_.get(), config_.outbound);
+        } else {
+            reactor = std::make_unique<Reactor>(*pool_, engine_.get(), config_.outbound);
+        }
+        if (config_.low_latency) reactor->setLowLatency(config_.busy_poll_us);
+        reactor->setDrainTimeout(config_.drain_timeout_ms);
+        std::function<void()> on_timer;
+        if (i == 0) on_timer = [this] { handleTimer(); };
+        if (!reactor->init(config_.port, sharded, std::move(on_timer))) {
+            return false;
+        }
+        reactors_.push_back(std::move(reactor));
     }
-    int yes = 1;
-    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
 
-    sockaddr_in addr{};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port_);
-    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);  // 127.0.0.1
-    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
-        std::perror("bind");
-        return false;
+    ServerStats::instance().setWorkerPool(pool_.get());
+    // here rather than in the first stats request, which would stall on it
+    tsc::calibrate();
+    if (replay_pending_) {
+        // first tick right away, the rest paced by handleTimer()
+        replay_origin_ns_ = steadyNs();
+        replay_first_ms_ = replay_->tick().time_ms;
+        reactors_[0]->scheduleTimer(replay_origin_ns_);
     }
-    if (listen(listen_fd_, SOMAXCONN) < 0) {
-        std::perror("listen");
-        return false;
+    if (config_.simulated) {
+        sim_started_ns_ = steadyNs();
+        reactors_[0]->scheduleTimer(sim_started_ns_);
     }
+    std::cout << "listening on 127.0.0.1:" << config_.port
+              << " (" << config_.reactors << (config_.io_uring ? " io_uring" : "") << " reactor(s), "
+              << pool_->size() << " worker(s)";
+    if (shards_) std::cout << ", " << shards_->size() << " engine thread(s)";
+    std::cout << (config_.low_latency ? ", low latency" : "") << ")\n";
+    return true;
+}
 
-    epoll_event ev{};
-    ev.events = EPOLLIN;
-    ev.data.fd = listen_fd_;
-    if (epoll_ctl(epfd_, EPOLL_CTL_ADD, listen_fd_, &ev) < 0) {
-        std::perror("epoll_ctl listen");
+bool TradeServer::initJournal() {
+    if (!config_.journal.empty() && !config_.replay.empty()) {
+        std::cerr << "journal and replay are exclusive\n";
         return false;
     }
-
-    // 2) timerfd for periodic tasks (250ms)
-    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
-    if (timer_fd_ < 0) {
-        std::perror("timerfd_create");
+    if ((!config_.journal.empty() || !config_.replay.empty()) && !mdg_) {
+        std::cerr << "journal and replay need a market data generator\n";
         return false;
     }
-    itimerspec its{};
-    its.it_interval.tv_sec = 0;
-    its.it_interval.tv_nsec = 250000000; // 250 ms
-    its.it_value.tv_sec = 0;
-    its.it_value.tv_nsec = 250000000;
-    if (timerfd_settime(timer_fd_, 0, &its, nullptr) < 0) {
-        std::perror("timerfd_settime");
-        return false;
+    std::vector<std::string> names;
+    if (mdg_) {
+        for (SymbolId id = 0; id < mdg_->symbolCount(); ++id) names.push_back(mdg_->symbolName(id));
     }
-    epoll_event tev{};
-    tev.events = EPOLLIN;
-    tev.data.fd = timer_fd_;
-    if (epoll_ctl(epfd_, EPOLL_CTL_ADD, timer_fd_, &tev) < 0) {
-        std::perror("epoll_ctl timer");
-        return false;
+
+    if (!config_.journal.empty()) {
+        auto journal = std::make_unique<JournalWriter>();
+        if (!journal->open(config_.journal, names)) return false;
+        mdg_->setJournal(std::move(journal));
+        std::cout << "journaling market data to " << config_.journal << "\n";
     }
 
-    std::cout << "listening on 127.0.0.1:" << port_ << "\n";
+    if (!config_.replay.empty()) {
+        replay_ = std::make_unique<JournalReader>();
+        if (!replay_->open(config_.replay)) return false;
+        if (replay_->symbols() != names) {
+            std::cerr << config_.replay << ": its " << replay_->symbols().size()
+                      << " symbols do not match the " << names.size() << " served\n";
+            return false;
+        }
+        replay_pending_ = replay_->next();
+        std::cout << "replaying " << config_.replay << " at ";
+        if (config_.replay_speed > 0) std::cout << config_.replay_speed << "x\n";
+        else std::cout << "full speed\n";
+    }
     return true;
 }
 
-void TradeServer::run() {
-    running_ = true;
-    epoll_event events[1024];
-    while (running_) {
-        int n = epoll_wait(epfd_, events, 1024, -1);
-        if (n < 0) {
-            if (errno == EINTR) continue;
-            std::perror("epoll_wait");
-            break;
-        }
-        for (int i = 0; i < n; ++i) {
-            int fd = events[i].data.fd;
-            uint32_t e = events[i].events;
-
-            if (fd == listen_fd_ && (e & EPOLLIN)) {
-                handleAccept();
-            } else if (fd == timer_fd_ && (e & EPOLLIN)) {
-                handleTimer();
-            } else {
-                if (e & (EPOLLHUP | EPOLLERR)) {
-                    closeClient(fd);
-                    continue;
-                }
-                if (e & EPOLLIN) {
-                    handleReadable(fd);
-                }
-                if (e & EPOLLOUT) handleWritable(fd);
-            }
-        }
+bool TradeServer::initOrderLog() {
+    if (config_.order_log.empty()) return true;
+    if (!mdg_) {
+        std::cerr << "the order log needs a market data generator\n";
+        return false;
     }
-}
+    std::vector<std::string> names;
+    for (SymbolId id = 0; id < mdg_->symbolCount(); ++id) names.push_back(mdg_->symbolName(id));
 
-void TradeServer::stop() {
-    if (!running_) return;
-    running_ = false;
-    // Close clients
-    for (auto it = clients_.begin(); it != clients_.end(); ) {
-        int fd = it->first;
-        epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
-        close(fd);
-        it = clients_.erase(it);
-    }
-    if (timer_fd_ >= 0) { epoll_ctl(epfd_, EPOLL_CTL_DEL, timer_fd_, nullptr); close(timer_fd_); timer_fd_ = -1; }
-    if (listen_fd_ >= 0) { epoll_ctl(epfd_, EPOLL_CTL_DEL, listen_fd_, nullptr); close(listen_fd_); listen_fd_ = -1; }
-    if (epfd_ >= 0) { close(epfd_); epfd_ = -1; }
+    OrderLogRecovery recovered;
+    order_log_ = std::make_unique<OrderLog>();
+    if (!order_log_->open(config_.order_log, names, recovered)) return false;
+    engine_->setOrderLog(order_log_.get());
+    engine_->recover(recovered);
+    order_log_->start();
+    std::cout << "order log " << config_.order_log << ": " << recovered.events << " events replayed, "
+              << recovered.orders << " resting order(s) recovered\n";
+    return true;
 }
 
-void TradeServer::broadcast(std::string data) {
-    for (auto& [fd, c] : clients_) {
-        c->appendToWriteBuffer(data);
-        notifyWritable(fd);
+void TradeServer::run() {
+    if (reactors_.empty()) return;
+    auto pin = [this](size_t i) {
+        if (i < config_.cpus.size()) lowlatency::pinThread(config_.cpus[i]);
+    };
+    for (size_t i = 1; i < reactors_.size(); ++i) {
+        threads_.emplace_back([this, i, pin] {
+            pin(i);
+            reactors_[i]->run();
+        });
+    }
+    pin(0);
+    reactors_[0]->run();
+    // first loop exited (stop or fatal error): bring the rest down too
+    stop();
+    for (auto& t : threads_) {
+        if (t.joinable()) t.join();
     }
+    threads_.clear();
 }
 
-void TradeServer::handleAccept() {
-    for (;;) {
-        int cfd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
-        if (cfd < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
-            std::perror("accept");
-            break;
-        }
-        auto cli = std::make_unique<Client>(cfd);
-        // When client has new data to send, arm EPOLLOUT on its fd
-        cli->setWritableNotifier([this](int fd){ this->notifyWritable(fd); });
-        epoll_event ce{};
-        ce.events = EPOLLIN; // start with read interest only
-        ce.data.fd = cfd;
-        if (epoll_ctl(epfd_, EPOLL_CTL_ADD, cfd, &ce) < 0) {
-            std::perror("epoll_ctl add client");
-            close(cfd);
-            continue;
-        }
-        clients_.emplace(cfd, std::move(cli));
-    }
+void TradeServer::stop() {
+    for (auto& r : reactors_) r->stop();
 }
 
 void TradeServer::handleTimer() {
-    // drain timer ticks
-    std::uint64_t ticks;
-    while (read(timer_fd_, &ticks, sizeof(ticks)) > 0) {}
+    ServerStats::instance().roll(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    if (config_.simulated && !advanceSimClock()) return;
+    if (!mdg_) return;
 
-    if (mdg_) {
-        std::string payload = mdg_->makeMarketData();
-        broadcast(std::move(payload));
-    }
-}
-
-void TradeServer::handleReadable(int fd) {
-    auto it = clients_.find(fd);
-    if (it == clients_.end()) return;
-    Client* client = it->second.get();
-    char buf[4096];
-    for (;;) {
-        ssize_t r = read(fd, buf, sizeof(buf));
-        if (r > 0) {
-            client->appendToReadBuffer(std::string(buf, r));
-        } else if (r == 0) {
-            closeClient(fd);
-            return;
-        } else {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
-            closeClient(fd);
-            return;
-        }
+    auto frame = std::make_shared<MarketDataFrame>();
+    frame->json = replay_ ? replayTick() : mdg_->makeMarketData();
+    if (!frame->json) return;   // no book changed and no snapshot due
+    size_t binary_clients = 0;
+    for (auto& r : reactors_) binary_clients += r->binaryClients();
+    if (binary_clients > 0) {
+        frame->binary = mdg_->makeMarketDataBinary();
     }
-    while (client->tryParseReadBuffer()) {
-        // messages will be queued and processed by client's worker thread
+    if (engine_->filteredSessions() > 0) {
+        mdg_->makeSymbolFrames(true, binary_clients > 0, frame->symbols);
     }
-    // If client enqueued response meanwhile, ensure writable is armed
-    // We check at write time; alternatively add hasPendingWrite() and arm here.
-}
 
-void TradeServer::handleWritable(int fd) {
-    auto it = clients_.find(fd);
-    if (it == clients_.end()) return;
-    Client* client = it->second.get();
-    // Ask client to flush its buffered data
-    ssize_t sent = client->flushWriteBufferNonBlocking();
-    (void)sent;
-    // If no more pending data, remove EPOLLOUT interest
-    // Keep EPOLLIN to continue reading.
-    epoll_event ev{};
-    ev.events = EPOLLIN;
-    ev.data.fd = fd;
-    // Only clear EPOLLOUT when buffer is empty
-    if (epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev) < 0) {
-        std::perror("epoll_ctl mod clear EPOLLOUT");
+    // we are on reactor 0; the others get the shared frame via their mailbox
+    reactors_[0]->broadcast(*frame);
+    for (size_t i = 1; i < reactors_.size(); ++i) {
+        Reactor* r = reactors_[i].get();
+        r->post([r, frame] { r->broadcast(*frame); });
     }
 }
 
-void TradeServer::closeClient(int fd) {
-    epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
-    close(fd);
-    clients_.erase(fd);
+std::shared_ptr<const std::string> TradeServer::replayTick() {
+    if (!replay_pending_) return nullptr;
+    const std::int64_t recorded_ms = replay_->tick().time_ms;
+    auto json = mdg_->replayMarketData(replay_->tick());
+    ++replay_ticks_;
+    replay_pending_ = replay_->next();
+    if (!replay_pending_) {
+        // the timer is one-shot now, so nothing fires after this
+        std::cout << "replay finished: " << replay_ticks_ << " ticks, "
+                  << recorded_ms - replay_first_ms_ << " ms recorded, replayed in "
+                  << (steadyNs() - replay_origin_ns_) / 1000000 << " ms" << std::endl;
+        return json;
+    }
+    // due times are offsets from the first tick, so pacing does not drift
+    std::int64_t due = steadyNs();
+    if (config_.replay_speed > 0) {
+        due = replay_origin_ns_ + static_cast<std::int64_t>(
+            static_cast<double>(replay_->tick().time_ms - replay_first_ms_) * 1e6 / config_.replay_speed);
+    }
+    reactors_[0]->scheduleTimer(due);
+    return json;
 }
 
-void TradeServer::notifyWritable(int fd) {
-    epoll_event ev{};
-    ev.events = EPOLLIN | EPOLLOUT;
-    ev.data.fd = fd;
-    if (epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev) < 0) {
-        std::perror("epoll_ctl mod writable");
+bool TradeServer::advanceSimClock() {
+    sim_now_ms_ += Reactor::kTimerIntervalMs;
+    if (config_.sim_duration_ms > 0 && sim_now_ms_ > config_.sim_duration_ms) {
+        const std::int64_t wall_ms = (steadyNs() - sim_started_ns_) / 1000000;
+        std::cout << "simulated " << config_.sim_duration_ms << " ms in " << wall_ms << " ms" << std::endl;
+        stop();
+        return false;
     }
+    // one-shot and already due: the loop serves pending I/O, then ticks again
+    reactors_[0]->scheduleTimer(steadyNs());
+    return true;
 }
-
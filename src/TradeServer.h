@@ -1,61 +1,139 @@
 // TradeServer.h
 // A minimal epoll-based TCP server wrapper for TradeSim.
-// It owns the listening socket, epoll instance and a periodic timer,
-// accepts clients, dispatches readable events to Client instances,
-// and provides a simple broadcast facility for market data.
+// It runs one or more Reactor event loops (each with its own listening
+// socket, epoll instance or io_uring, and clients), owns the shared worker
+// pool, engine shards, order entry engine and market data generator, and
+// fans each market data tick out to every reactor.
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
-#include <unordered_map>
+#include <string>
+#include <thread>
+#include <vector>
 
-struct epoll_event;
+#include "OutboundQueue.h"
 
-class Client;                // forward declaration (defined in Client.h)
+class EngineShards;          // forward declaration (defined in EngineShards.h)
+class JournalReader;         // forward declaration (defined in MarketDataJournal.h)
 class MarketDataGenerator;   // forward declaration (defined in MarketDataGenerator.h)
+class MatchingEngine;        // forward declaration (defined in MatchingEngine.h)
+class OrderLog;              // forward declaration (defined in OrderLog.h)
+class Reactor;               // forward declaration (defined in Reactor.h)
+class WorkerPool;            // forward declaration (defined in WorkerPool.h)
+
+struct ServerConfig {
+    uint16_t port = 8000;
+    size_t worker_threads = 0;  // 0 = one per core
+    // Engine threads owning the order books, each a share of the symbols
+    // (see EngineShards.h): order entry and book ticks run there without
+    // book locks. 0 = off, order entry runs on the workers under each
+    // book's lock.
+    size_t engine_threads = 0;
+    // Number of event loops. With more than one, every reactor binds the
+    // port with SO_REUSEPORT and the kernel shards connections across them.
+    size_t reactors = 1;
+    // Run the reactors on io_uring (UringReactor, Linux 6.0+) instead of epoll.
+    bool io_uring = false;
+    // Low-latency mode: reactors, engine threads and workers spin-poll instead of sleeping
+    // (each keeps a core busy), client sockets get TCP_NODELAY and
+    // SO_BUSY_POLL (busy_poll_us, 0 = off), and memory is prefaulted and
+    // locked at startup.
+    bool low_latency = false;
+    int busy_poll_us = 50;
+    // Cores to pin threads to, in order: the reactors (the first one runs
+    // on the thread calling run()), then the engine threads, then the
+    // workers. Threads past the end of the list are not pinned.
+    std::vector<int> cpus{};
+    // Per-connection outbound backlog limits (conflation, slow consumer disconnect).
+    OutboundLimits outbound{};
+    // On stop(), keep sending what is already queued to clients for up to
+    // this long before closing them (0 = close right away).
+    std::int64_t drain_timeout_ms = 1000;
+    // Market data journal (see MarketDataJournal.h): record every tick to
+    // `journal`, or publish the ticks recorded in `replay` instead of
+    // generating them, replay_speed times as fast as recorded (0 = no
+    // pacing). The generator's symbols must match the journal's.
+    std::string journal{};
+    std::string replay{};
+    double replay_speed = 1.0;
+    // Write-ahead log of order events (see OrderLog.h): replayed into the
+    // books at startup, and order responses and execution reports are only
+    // sent once their events are on disk. Empty = no log.
+    std::string order_log{};
+    // Simulated time: market data ticks run back to back, each advancing a
+    // virtual clock (starting at 0) by one timer interval, and the server
+    // stops once it passes sim_duration_ms (0 = never). With a seeded
+    // generator this makes runs reproducible and hours of market activity
+    // take seconds.
+    bool simulated = false;
+    std::int64_t sim_duration_ms = 0;
+};
 
 class TradeServer {
 public:
     // Construct without starting the loop. Call init() then run().
+    explicit TradeServer(const ServerConfig& config);
     explicit TradeServer(uint16_t port = 8000);
     ~TradeServer();
 
-    // Create listen socket, epoll fd and timerfd.
+    // Create the reactors (listen sockets, epoll fds, timerfd on the first).
     // Return true on success.
     bool init();
 
-    // Blocking event loop; returns when stop() is called or fatal error.
+    // Blocking: runs the first reactor on the calling thread and the others
+    // on their own threads; returns when stop() is called or fatal error.
     void run();
 
-    // Request loop to exit gracefully.
+    // Request all loops to exit gracefully, after the outbound drain
+    // (thread-safe and async-signal-safe).
     void stop();
 
-    // Helper to arm EPOLLOUT when there is pending data
-    void notifyWritable(int fd);
-    
     // Set market data generator used on timer ticks (server takes ownership).
+    // Its books also back order entry. Call before init().
     void setMarketDataGenerator(std::unique_ptr<MarketDataGenerator> mdg);
 
 private:
-
-    // Broadcast raw bytes to all clients (thread-safe).
-    void broadcast(std::string data);
-    // Handlers for epoll events
-    void handleAccept();
+    // Timer callback on the first reactor: build one tick and hand it to all.
     void handleTimer();
-    void handleReadable(int fd);
-    void handleWritable(int fd);
-    void closeClient(int fd);
+    // Replay: publish the pending journal tick and arm the timer for the
+    // next one; null once the journal is exhausted.
+    std::shared_ptr<const std::string> replayTick();
+    bool initJournal();
+    bool initOrderLog();
+    // Simulated run: advance the virtual clock and schedule the next tick
+    // right away; false once the run is over (the server is stopping).
+    bool advanceSimClock();
 
-    uint16_t port_;
-    int epfd_{-1};
-    int listen_fd_{-1};
-    int timer_fd_{-1};
-    bool running_{false};
+    ServerConfig config_;
 
-    // All active clients, keyed by fd (value owns per-connection state).
-    std::unordered_map<int, std::unique_ptr<Client>> clients_;
+    // Runs Message::handle() for every connection; must outlive the reactors.
+    std::unique_ptr<WorkerPool> pool_;
+    // Owners of the books when sharded; outlive the generator and clients.
+    std::unique_ptr<EngineShards> shards_;
 
     // Market data generator for periodic broadcast.
     std::unique_ptr<MarketDataGenerator> mdg_;
+    // Order entry on top of the generator's books.
+    std::unique_ptr<MatchingEngine> engine_;
+    // Destroyed before the engine (its commit thread delivers reports
+    // through it) and after the reactors (clients wait for their acks).
+    std::unique_ptr<OrderLog> order_log_;
+
+    // Virtual clock of a simulated run; timer thread only.
+    std::int64_t sim_now_ms_ = 0;
+    std::int64_t sim_started_ns_ = 0;
+
+    // Replay source; the pending tick is replay_->tick() while replay_pending_.
+    std::unique_ptr<JournalReader> replay_;
+    bool replay_pending_ = false;
+    std::int64_t replay_origin_ns_ = 0;     // steady time the first tick went out
+    std::int64_t replay_first_ms_ = 0;      // its recorded timestamp
+    std::uint64_t replay_ticks_ = 0;
+
+    // Declared last so clients go before the engine and pool they use.
+    std::vector<std::unique_ptr<Reactor>> reactors_;
+    std::vector<std::thread> threads_;
 };
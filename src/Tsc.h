@@ -0,0 +1,64 @@
+// Tsc.h
+// Cheap timestamps for latency instrumentation: the CPU time stamp counter
+// on x86 (invariant on every machine we run on, so ticks are comparable
+// across cores), steady_clock nanoseconds elsewhere. Only differences are
+// meaningful; turn them into nanoseconds with tsc::nanosPerTick(), after
+// tsc::calibrate().
+
+#pragma once
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace tsc {
+
+inline std::int64_t steadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+inline std::uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(steadyNs());
+#endif
+}
+
+namespace detail {
+struct Origin {
+    std::uint64_t ticks;
+    std::int64_t ns;
+};
+inline const Origin& origin() {
+    static const Origin origin{now(), steadyNs()};
+    return origin;
+}
+constexpr std::int64_t kMinSpanNs = 5'000'000;
+} // namespace detail
+
+// Take the origin of nanosPerTick() and spin until it is a few ms old.
+// Call once before serving (TradeServer::init does).
+inline void calibrate() {
+    const detail::Origin& origin = detail::origin();
+    while (steadyNs() - origin.ns < detail::kMinSpanNs) {
+    }
+}
+
+// Tick rate measured against steady_clock since calibrate(), so it gets
+// more precise as the process runs.
+inline double nanosPerTick() {
+    const detail::Origin& origin = detail::origin();
+    const std::int64_t ns = steadyNs();
+    assert(ns - origin.ns >= detail::kMinSpanNs && "tsc::calibrate() was not called");
+    const std::uint64_t ticks = now() - origin.ticks;
+    return ticks ? static_cast<double>(ns - origin.ns) / static_cast<double>(ticks) : 1.0;
+}
+
+} // namespace tsc
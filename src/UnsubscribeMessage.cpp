@@ -0,0 +1,9 @@
+#include "UnsubscribeMessage.h"
+#include "MessagePool.h"
+
+
+MessagePtr UnsubscribeMessage::fromBinary(MessageType type_, std::string_view payload, MessagePool& pool) {
+    MessagePtr out = pool.create<UnsubscribeMessage>(type_);
+    if (!static_cast<UnsubscribeMessage*>(out.get())->decode(payload)) return nullptr;
+    return out;
+}
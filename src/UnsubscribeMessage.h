@@ -0,0 +1,16 @@
+#pragma once
+
+#include "SubscriptionMessage.h"
+
+#include <string_view>
+
+// Stop receiving market data for the listed symbols (from every symbol,
+// if the client had not subscribed explicitly).
+class UnsubscribeMessage : public SubscriptionMessage {
+    explicit UnsubscribeMessage(MessageType type_) : SubscriptionMessage(type_) {}
+    friend class MessagePool;
+public:
+    UnsubscribeMessage(MessageType type_, json j) : SubscriptionMessage(type_, std::move(j)) {}
+    // Decode a wire::SubscriptionRequest payload; nullptr if malformed.
+    static MessagePtr fromBinary(MessageType type_, std::string_view payload, MessagePool& pool);
+};
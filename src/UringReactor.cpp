@@ -0,0 +1,373 @@
+#include "UringReactor.h"
+
+#include "Client.h"
+#include "ServerStats.h"
+#include "Tsc.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+UringReactor::UringReactor(WorkerPool& pool, MatchingEngine* engine, const OutboundLimits& limits)
+    : Reactor(pool, engine, limits) {}
+
+UringReactor::~UringReactor() {
+    // run() drained the ring; connections closed while their operations
+    // were in flight still hold their Client
+    for (auto& [fd, conn] : conns_) {
+        if (conn->closing) reclaim(fd, std::move(conn->closing));
+    }
+}
+
+bool UringReactor::initLoop() {
+    return ring_.init(kSubmitEntries, kCompleteEntries) &&
+           ring_.setupBuffers(kBufferGroup, kBufferCount, kBufferSize);
+}
+
+void UringReactor::run() {
+    loop_thread_ = std::this_thread::get_id();
+    // the submitting thread, when the ring is single issuer
+    if (!ring_.enable()) return;
+    running_ = true;
+    armAccept();
+    armPoll(wake_fd_, Op::PollWake);
+    if (timer_fd_ >= 0) armPoll(timer_fd_, Op::PollTimer);
+    // spinning: reap whatever completed without waiting
+    const unsigned wait_nr = spin_ ? 0 : 1;
+    while (running_) {
+        flushSends();
+        const int r = ring_.submitAndWait(wait_nr);
+        if (r < 0 && r != -EINTR && r != -EAGAIN && r != -EBUSY) {
+            errno = -r;
+            std::perror("io_uring_enter");
+            break;
+        }
+        ring_.forEachCompletion([this](const io_uring_cqe& cqe) { handleCompletion(cqe); });
+        if (reapRetired() && !spin_) armTick();
+    }
+    flushOnStop();
+    drain();
+}
+
+void UringReactor::flushOnStop() {
+    const std::int64_t deadline = tsc::steadyNs() + drain_timeout_ms_ * 1000000;
+    while (tsc::steadyNs() < deadline) {
+        bool pending = false;
+        for (auto& [fd, conn] : conns_) {
+            if (conn->closing) continue;
+            if (!conn->send_inflight && clients_.at(fd)->hasPendingWrite()) queueSend(fd);
+            pending = pending || conn->send_queued || conn->send_inflight;
+        }
+        if (!pending) break;
+        flushSends();
+        armTick();
+        const int r = ring_.submitAndWait(1);
+        if (r < 0 && r != -EINTR && r != -EAGAIN && r != -EBUSY) break;
+        ring_.forEachCompletion([this](const io_uring_cqe& cqe) { handleCompletion(cqe); });
+    }
+}
+
+void UringReactor::drain() {
+    if (io_uring_sqe* e = submission(Op::Cancel, -1)) {
+        e->opcode = IORING_OP_ASYNC_CANCEL;
+        e->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+    }
+    while (inflight_ > 0) {
+        const int r = ring_.submitAndWait(1);
+        if (r < 0 && r != -EINTR && r != -EAGAIN && r != -EBUSY) break;
+        ring_.forEachCompletion([this](const io_uring_cqe& cqe) { handleCompletion(cqe); });
+    }
+}
+
+io_uring_sqe* UringReactor::submission(Op op, int fd) {
+    io_uring_sqe* e = ring_.sqe();
+    if (!e) {
+        std::fprintf(stderr, "io_uring: submission queue full\n");
+        return nullptr;
+    }
+    e->fd = fd;
+    e->user_data = userData(op, fd);
+    if (op != Op::Cancel) ++inflight_;
+    return e;
+}
+
+void UringReactor::armAccept() {
+    io_uring_sqe* e = submission(Op::Accept, listen_fd_);
+    if (!e) return;
+    e->opcode = IORING_OP_ACCEPT;
+    e->ioprio = IORING_ACCEPT_MULTISHOT;
+    // blocking sockets: io_uring waits for readiness itself rather than
+    // completing with -EAGAIN
+    e->accept_flags = SOCK_CLOEXEC;
+}
+
+void UringReactor::armPoll(int fd, Op op) {
+    io_uring_sqe* e = submission(op, fd);
+    if (!e) return;
+    e->opcode = IORING_OP_POLL_ADD;
+    e->len = IORING_POLL_ADD_MULTI;
+    e->poll32_events = POLLIN;
+}
+
+void UringReactor::armRecv(int fd, Conn& conn) {
+    io_uring_sqe* e = submission(Op::Recv, fd);
+    if (!e) return;
+    e->opcode = IORING_OP_RECV;
+    e->ioprio = IORING_RECV_MULTISHOT;
+    e->flags = IOSQE_BUFFER_SELECT;
+    e->buf_group = kBufferGroup;
+    conn.recv_armed = true;
+}
+
+void UringReactor::armTick() {
+    static const __kernel_timespec kTick{0, kReapIntervalMs * 1000000LL};
+    if (tick_armed_) return;
+    io_uring_sqe* e = submission(Op::Tick, -1);
+    if (!e) return;
+    e->opcode = IORING_OP_TIMEOUT;
+    e->addr = reinterpret_cast<std::uint64_t>(&kTick);
+    e->len = 1;
+    tick_armed_ = true;
+}
+
+void UringReactor::notifyWritable(int fd) {
+    if (std::this_thread::get_id() == loop_thread_) {
+        queueSend(fd);
+        return;
+    }
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(writable_mutex_);
+        wake = writable_.empty();
+        writable_.push_back(fd);
+    }
+    if (wake) {
+        std::uint64_t one = 1;
+        if (write(wake_fd_, &one, sizeof(one)) < 0) {
+            // counter saturated: the loop is already due to wake up
+        }
+    }
+}
+
+void UringReactor::queueSend(int fd) {
+    auto it = conns_.find(fd);
+    if (it == conns_.end()) return;
+    Conn& conn = *it->second;
+    if (conn.closing || conn.send_queued) return;
+    conn.send_queued = true;
+    sendable_.push_back(fd);
+}
+
+void UringReactor::flushSends() {
+    for (int fd : sendable_) {
+        auto it = conns_.find(fd);
+        if (it == conns_.end()) continue;
+        Conn& conn = *it->second;
+        conn.send_queued = false;
+        // one send at a time per connection; its completion re-checks
+        if (conn.closing || conn.send_inflight) continue;
+        Client* client = clients_.at(fd).get();
+        const std::size_t n = client->gatherWriteBuffer(conn.iov, kMaxIov);
+        if (n == 0) {
+            client->completeWrite(0);
+            continue;
+        }
+        io_uring_sqe* e = submission(Op::Send, fd);
+        if (!e) {
+            client->completeWrite(0);
+            continue;
+        }
+        conn.msg = msghdr{};
+        conn.msg.msg_iov = conn.iov;
+        conn.msg.msg_iovlen = n;
+        conn.sending = 0;
+        for (std::size_t i = 0; i < n; ++i) conn.sending += conn.iov[i].iov_len;
+        e->opcode = IORING_OP_SENDMSG;
+        e->addr = reinterpret_cast<std::uint64_t>(&conn.msg);
+        e->msg_flags = MSG_NOSIGNAL;
+        // skip the attempt that would fail on a full socket
+        if (conn.poll_first) e->ioprio = IORING_RECVSEND_POLL_FIRST;
+        conn.send_inflight = true;
+    }
+    sendable_.clear();
+}
+
+void UringReactor::handleCompletion(const io_uring_cqe& cqe) {
+    const auto op = static_cast<Op>(cqe.user_data >> 32);
+    const int fd = static_cast<int>(cqe.user_data & 0xffffffffu);
+    // a multishot operation stays armed while its completions carry F_MORE
+    const bool more = cqe.flags & IORING_CQE_F_MORE;
+    if (op != Op::Cancel && !more) --inflight_;
+    switch (op) {
+    case Op::Accept:
+        if (cqe.res >= 0) {
+            handleAccepted(cqe.res);
+        } else if (cqe.res != -ECANCELED) {
+            errno = -cqe.res;
+            std::perror("accept");
+        }
+        if (!more && running_) armAccept();
+        break;
+    case Op::Recv:
+        handleReceived(fd, cqe);
+        break;
+    case Op::Send:
+        handleSent(fd, cqe.res);
+        break;
+    case Op::PollWake:
+        if (cqe.res >= 0) handleWake();
+        if (!more && running_) armPoll(wake_fd_, Op::PollWake);
+        break;
+    case Op::PollTimer:
+        // no more market data once stopping
+        if (cqe.res >= 0 && running_) handleTimer();
+        if (!more && running_) armPoll(timer_fd_, Op::PollTimer);
+        break;
+    case Op::Tick:
+        tick_armed_ = false;
+        break;
+    case Op::Cancel:
+        break;
+    }
+}
+
+void UringReactor::handleAccepted(int fd) {
+    addClient(fd);
+    auto& conn = conns_[fd];
+    conn = std::make_unique<Conn>();
+    armRecv(fd, *conn);
+}
+
+void UringReactor::handleReceived(int fd, const io_uring_cqe& cqe) {
+    auto it = conns_.find(fd);
+    if (it == conns_.end()) return;
+    Conn& conn = *it->second;
+    if (!(cqe.flags & IORING_CQE_F_MORE)) conn.recv_armed = conn.recv_stopping = false;
+    const int res = cqe.res;
+    const bool open = !conn.closing;
+    const bool buffer = cqe.flags & IORING_CQE_F_BUFFER;
+    const auto bid = static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+    // stopping: requests are no longer read
+    if (res > 0 && open && running_) {
+        ServerStats& stats = ServerStats::instance();
+        const std::uint64_t started = tsc::now();
+        Client* client = clients_.at(fd).get();
+        ReadBuffer& in = client->readBuffer();
+        char* dst = in.prepare(static_cast<std::size_t>(res));
+        if (dst) {
+            std::memcpy(dst, ring_.buffer(bid), static_cast<std::size_t>(res));
+            in.commit(static_cast<std::size_t>(res));
+        }
+        ring_.recycleBuffer(bid);
+        if (!dst) {
+            // a single unfinished frame outgrew the largest buffer
+            closeClient(fd);
+        } else {
+            stats.addBytesIn(static_cast<std::size_t>(res));
+            if (parseInput(fd, client)) {
+                in.releaseIfEmpty();
+                stats.record(ServerStats::Stage::Read, tsc::now() - started);
+            }
+        }
+    } else {
+        if (buffer) ring_.recycleBuffer(bid);
+        // end of stream or a socket error; -ENOBUFS only ran the
+        // buffer ring dry and -ECANCELED is a close or stop in progress
+        if (open && res <= 0 && res != -ENOBUFS && res != -ECANCELED) closeClient(fd);
+    }
+
+    // closeClient() may have released the connection
+    it = conns_.find(fd);
+    if (it == conns_.end() || it->second->recv_armed) return;
+    if (it->second->closing) {
+        release(fd);
+    } else if (running_ && !clients_.at(fd)->readPaused() && (res > 0 || res == -ENOBUFS || res == -ECANCELED)) {
+        // -ECANCELED: stopReading(), and resumed meanwhile
+        armRecv(fd, *it->second);
+    }
+}
+
+void UringReactor::stopReading(int fd, Client&) {
+    Conn& conn = *conns_.at(fd);
+    if (!conn.recv_armed || conn.recv_stopping) return;
+    if (io_uring_sqe* e = submission(Op::Cancel, fd)) {
+        e->opcode = IORING_OP_ASYNC_CANCEL;
+        e->addr = userData(Op::Recv, fd);
+        conn.recv_stopping = true;
+    }
+}
+
+void UringReactor::startReading(int fd, Client&) {
+    Conn& conn = *conns_.at(fd);
+    // still armed: its last completion re-arms it
+    if (!conn.recv_armed && running_) armRecv(fd, conn);
+}
+
+void UringReactor::handleSent(int fd, int res) {
+    auto it = conns_.find(fd);
+    if (it == conns_.end()) return;
+    Conn& conn = *it->second;
+    conn.send_inflight = false;
+    if (conn.closing) {
+        conn.closing->completeWrite(0);
+        release(fd);
+        return;
+    }
+    Client* client = clients_.at(fd).get();
+    client->completeWrite(res > 0 ? static_cast<std::size_t>(res) : 0);
+    if (res > 0) {
+        ServerStats::instance().addBytesOut(static_cast<std::size_t>(res));
+        conn.poll_first = static_cast<std::size_t>(res) < conn.sending;
+    } else if (res == 0 || res == -EAGAIN) {
+        conn.poll_first = true;
+    } else if (res != -ECANCELED) {
+        closeClient(fd);
+        return;
+    }
+    if (client->hasPendingWrite() && running_) queueSend(fd);
+}
+
+void UringReactor::handleWake() {
+    handleMailbox();
+    woken_.clear();
+    {
+        std::lock_guard<std::mutex> lock(writable_mutex_);
+        woken_.swap(writable_);
+    }
+    for (int fd : woken_) queueSend(fd);
+}
+
+void UringReactor::closeClient(int fd) {
+    auto it = clients_.find(fd);
+    if (it == clients_.end()) return;
+    if (it->second->protocol() == WireProtocol::Binary) {
+        binary_clients_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    Conn& conn = *conns_.at(fd);
+    conn.closing = std::move(it->second);
+    clients_.erase(it);
+    conn.closing->retire();
+    ServerStats::instance().connectionClosed();
+    if (conn.recv_armed || conn.send_inflight) {
+        // the receive and a send waiting for socket space never end by themselves
+        if (io_uring_sqe* e = submission(Op::Cancel, fd)) {
+            e->opcode = IORING_OP_ASYNC_CANCEL;
+            e->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        }
+    }
+    release(fd);
+}
+
+void UringReactor::release(int fd) {
+    auto it = conns_.find(fd);
+    if (it == conns_.end()) return;
+    Conn& conn = *it->second;
+    if (!conn.closing || conn.recv_armed || conn.send_inflight) return;
+    std::unique_ptr<Client> client = std::move(conn.closing);
+    conns_.erase(it);
+    reclaim(fd, std::move(client));
+}
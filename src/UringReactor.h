@@ -0,0 +1,115 @@
+// UringReactor.h
+// Reactor on io_uring instead of epoll + read/sendmsg. The listening
+// socket has one multishot accept, each connection one multishot receive
+// drawing from a provided buffer ring shared by the reactor's clients,
+// and the eventfd / timerfd multishot polls. Sends are gathered from each
+// dirty client's OutboundQueue and queued as SENDMSG entries; everything
+// queued during a loop iteration goes to the kernel in the one
+// io_uring_enter that also waits for the next completions, so a busy
+// loop makes one syscall per iteration instead of one per read, per
+// write and per EPOLLOUT change.
+
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "IoUring.h"
+#include "Reactor.h"
+
+class UringReactor final : public Reactor {
+public:
+    UringReactor(WorkerPool& pool, MatchingEngine* engine, const OutboundLimits& limits = {});
+    ~UringReactor() override;
+
+    void run() override;
+
+    // Thread-safe: queue a send of the client's pending data. Off the loop
+    // thread the fd is handed over through the mailbox eventfd.
+    void notifyWritable(int fd) override;
+
+protected:
+    // The ring (disabled until run()) and its receive buffers.
+    bool initLoop() override;
+    // The Client is retired right away but only reclaimed once its receive
+    // and send have completed, so neither the fd number nor the queued
+    // buffers are reused under them.
+    void closeClient(int fd) override;
+    void flushOnStop() override;
+    // Cancel the multishot receive; it is re-armed on its last completion
+    // unless the client is still paused by then.
+    void stopReading(int fd, Client& client) override;
+    void startReading(int fd, Client& client) override;
+
+private:
+    static constexpr unsigned kSubmitEntries = 4096;
+    static constexpr unsigned kCompleteEntries = 16384;
+    static constexpr std::uint16_t kBufferGroup = 0;
+    static constexpr unsigned kBufferCount = 1024;      // receive buffers, power of two
+    static constexpr unsigned kBufferSize = 4096;
+    static constexpr std::size_t kMaxIov = 64;          // segments per SENDMSG
+
+    // Kind of operation, kept in the high bits of user_data; the low bits
+    // hold the fd.
+    enum class Op : std::uint8_t { Accept, Recv, Send, PollWake, PollTimer, Cancel, Tick };
+
+    // io_uring state of one connection.
+    struct Conn {
+        std::unique_ptr<Client> closing;    // retired; waiting for its operations
+        bool recv_armed = false;
+        bool recv_stopping = false;         // its cancel is in flight
+        bool send_inflight = false;
+        bool send_queued = false;           // in sendable_
+        bool poll_first = false;            // the last send was short: socket full
+        msghdr msg{};                       // of the send in flight
+        iovec iov[kMaxIov];
+        std::size_t sending = 0;            // bytes in msg
+    };
+
+    static std::uint64_t userData(Op op, int fd) {
+        return (static_cast<std::uint64_t>(op) << 32) | static_cast<std::uint32_t>(fd);
+    }
+
+    // Next submission entry for op on fd; nullptr if the ring stays full
+    // even after flushing it to the kernel.
+    io_uring_sqe* submission(Op op, int fd);
+    void armAccept();
+    void armPoll(int fd, Op op);
+    void armRecv(int fd, Conn& conn);
+    // One-shot kReapIntervalMs timeout, so a blocked wait comes back.
+    void armTick();
+    void queueSend(int fd);
+    void flushSends();
+    // Cancel every operation and wait for them, at the end of run().
+    void drain();
+
+    void handleCompletion(const io_uring_cqe& cqe);
+    void handleAccepted(int fd);
+    void handleReceived(int fd, const io_uring_cqe& cqe);
+    void handleSent(int fd, int res);
+    void handleWake();
+    // Reclaim a closed connection's Client once nothing is in flight on it.
+    void release(int fd);
+
+    std::thread::id loop_thread_{};
+    std::size_t inflight_ = 0;              // operations with a final completion to come
+    bool tick_armed_ = false;
+
+    std::unordered_map<int, std::unique_ptr<Conn>> conns_;
+    std::vector<int> sendable_;             // dirty connections, sent before the next wait
+
+    // notifyWritable() from other threads.
+    std::mutex writable_mutex_;
+    std::vector<int> writable_;
+    std::vector<int> woken_;                // loop thread's side of writable_
+
+    // Last, so it goes first: nothing may still point into conns_.
+    IoUring ring_;
+};
@@ -0,0 +1,134 @@
+#include "WorkerPool.h"
+
+#include "LockFreeQueue.h"
+#include "LowLatency.h"
+
+#include <algorithm>
+
+namespace {
+// Identifies the pool/worker owning the current thread, for local submits.
+thread_local const WorkerPool* tl_pool = nullptr;
+thread_local std::size_t tl_index = 0;
+}
+
+WorkerPool::WorkerPool(std::size_t threads, bool spin, std::vector<int> cpus)
+    : spin_(spin), cpus_(std::move(cpus)) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    workers_.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    threads_.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back(&WorkerPool::run, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        stopping_ = true;
+    }
+    idle_cv_.notify_all();
+    for (auto& t : threads_) {
+        if (t.joinable()) t.join();
+    }
+}
+
+void WorkerPool::submit(Task task) {
+    std::size_t index = tl_pool == this ? tl_index
+                                        : next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    pending_.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+        workers_[index]->tasks.push_back(std::move(task));
+    }
+    // Pairs with the sleeping_/pending_ check in run(): either we see the
+    // sleeper or it sees our task, so the notify is never lost.
+    if (sleeping_.load() > 0) {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        idle_cv_.notify_one();
+    }
+}
+
+void WorkerPool::parallelFor(std::size_t n, std::size_t grain,
+                             const std::function<void(std::size_t, std::size_t)>& fn) {
+    grain = std::max<std::size_t>(grain, 1);
+    const std::size_t chunks = (n + grain - 1) / grain;
+    if (chunks <= 1) {
+        if (n > 0) fn(0, n);
+        return;
+    }
+    // Helpers may only get to run after we returned; they then find no
+    // chunk left and never touch fn, but the counters must still exist.
+    struct Shared {
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> done{0};
+    };
+    auto shared = std::make_shared<Shared>();
+    auto work = [shared, n, grain, chunks, &fn] {
+        for (;;) {
+            std::size_t c = shared->next.fetch_add(1, std::memory_order_relaxed);
+            if (c >= chunks) return;
+            fn(c * grain, std::min(n, (c + 1) * grain));
+            if (shared->done.fetch_add(1, std::memory_order_acq_rel) + 1 == chunks) {
+                shared->done.notify_one();
+            }
+        }
+    };
+    const std::size_t helpers = std::min(workers_.size(), chunks - 1);
+    for (std::size_t i = 0; i < helpers; ++i) submit(work);
+    work();
+    for (std::size_t d = shared->done.load(std::memory_order_acquire); d != chunks;
+         d = shared->done.load(std::memory_order_acquire)) {
+        shared->done.wait(d, std::memory_order_acquire);
+    }
+}
+
+bool WorkerPool::tryPop(std::size_t index, Task& task) {
+    {
+        Worker& own = *workers_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    for (std::size_t k = 1; k < workers_.size(); ++k) {
+        Worker& victim = *workers_[(index + k) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::run(std::size_t index) {
+    tl_pool = this;
+    tl_index = index;
+    if (index < cpus_.size()) lowlatency::pinThread(cpus_[index]);
+    Task task;
+    for (;;) {
+        if (tryPop(index, task)) {
+            pending_.fetch_sub(1);
+            task();
+            task = nullptr;
+            continue;
+        }
+        if (spin_) {
+            // never counted in sleeping_, so submit() skips the notify
+            if (stopping_.load() && pending_.load() == 0) break;
+            lockfree_detail::cpuRelax();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        sleeping_.fetch_add(1);
+        idle_cv_.wait(lock, [this] { return stopping_ || pending_.load() > 0; });
+        sleeping_.fetch_sub(1);
+        if (stopping_ && pending_.load() == 0) break;
+    }
+}
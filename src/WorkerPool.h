@@ -0,0 +1,66 @@
+// WorkerPool.h
+// Fixed pool of worker threads with per-worker task deques and work
+// stealing. A worker pops from the front of its own deque and, when that
+// is empty, steals from the back of the others'. Tasks submitted from a
+// worker thread go to that worker's deque; external submissions are spread
+// round-robin. Idle workers sleep on a condition variable, or spin when
+// the pool is built for low latency.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+
+    // threads == 0 sizes the pool to the number of cores. With spin, idle
+    // workers poll for tasks instead of sleeping (a core each); worker i
+    // is pinned to cpus[i] when there is one.
+    explicit WorkerPool(std::size_t threads = 0, bool spin = false, std::vector<int> cpus = {});
+    // Runs every task already submitted, then joins the workers.
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void submit(Task task);
+
+    // Run fn(begin, end) over [0, n) split into chunks of `grain`, on the
+    // workers and the calling thread; returns once every chunk is done.
+    // The caller works too, so this completes even when all workers are busy.
+    void parallelFor(std::size_t n, std::size_t grain,
+                     const std::function<void(std::size_t, std::size_t)>& fn);
+
+    std::size_t size() const { return threads_.size(); }
+    // Tasks submitted and not yet picked up by a worker.
+    std::size_t queued() const { return pending_.load(std::memory_order_relaxed); }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(std::size_t index);
+    bool tryPop(std::size_t index, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<std::size_t> next_{0};      // round-robin cursor for external submits
+    std::atomic<std::size_t> pending_{0};   // tasks queued but not yet taken
+    std::atomic<std::size_t> sleeping_{0};
+    std::mutex idle_mutex_;
+    std::condition_variable idle_cv_;
+    std::atomic<bool> stopping_{false};
+    const bool spin_;
+    const std::vector<int> cpus_;
+};
@@ -1,16 +1,117 @@
 // Refactored entry point using TradeServer abstraction
 #include "TradeServer.h"
 #include "MarketDataGenerator.h"
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <memory>
 
-int main() {
-    TradeServer server(8000);
-    server.setMarketDataGenerator(std::make_unique<MarketDataGenerator>());
+static void usage(const char* prog) {
+    std::cerr << "usage: " << prog << " [--port N] [--reactors N] [--io-uring] [--workers N] [--engine-threads N]\n"
+              << "       [--symbols N] [--outbound-limit BYTES] [--slow-grace MS] [--drain-timeout MS]\n"
+              << "       [--journal FILE | --replay FILE [--replay-speed X]]   (X = 0: as fast as possible)\n"
+              << "       [--order-log FILE] [--seed N] [--simulate [--sim-duration MS]]\n"
+              << "       [--low-latency [--busy-poll-us N]] [--cpus C,C,...]   (reactors, engine threads, workers)\n";
+}
+
+static TradeServer* g_server = nullptr;
+
+// SIGINT / SIGTERM: stop gracefully (outbound drain included). The handler
+// is reset, so a second signal kills the process.
+static void onSignal(int) {
+    if (g_server) g_server->stop();
+}
+
+int main(int argc, char** argv) {
+    ServerConfig config;
+    size_t symbols = 1;
+    uint64_t seed = 0;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(arg, "--port") == 0 && val) {
+            config.port = static_cast<uint16_t>(std::atoi(val));
+            ++i;
+        } else if (std::strcmp(arg, "--reactors") == 0 && val) {
+            config.reactors = static_cast<size_t>(std::atoi(val));
+            ++i;
+        } else if (std::strcmp(arg, "--io-uring") == 0) {
+            config.io_uring = true;
+        } else if (std::strcmp(arg, "--low-latency") == 0) {
+            config.low_latency = true;
+        } else if (std::strcmp(arg, "--busy-poll-us") == 0 && val) {
+            config.busy_poll_us = std::atoi(val);
+            ++i;
+        } else if (std::strcmp(arg, "--cpus") == 0 && val) {
+            for (const char* p = val; *p; ) {
+                char* end;
+                config.cpus.push_back(static_cast<int>(std::strtol(p, &end, 10)));
+                if (end == p) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                p = *end == ',' ? end + 1 : end;
+            }
+            ++i;
+        } else if (std::strcmp(arg, "--workers") == 0 && val) {
+            config.worker_threads = static_cast<size_t>(std::atoi(val));
+            ++i;
+        } else if (std::strcmp(arg, "--engine-threads") == 0 && val) {
+            config.engine_threads = static_cast<size_t>(std::atoi(val));
+            ++i;
+        } else if (std::strcmp(arg, "--symbols") == 0 && val) {
+            symbols = static_cast<size_t>(std::atoi(val));
+            ++i;
+        } else if (std::strcmp(arg, "--outbound-limit") == 0 && val) {
+            config.outbound.soft_bytes = static_cast<size_t>(std::atoll(val));
+            config.outbound.hard_bytes = 8 * config.outbound.soft_bytes;
+            ++i;
+        } else if (std::strcmp(arg, "--slow-grace") == 0 && val) {
+            config.outbound.grace_ms = std::atoll(val);
+            ++i;
+        } else if (std::strcmp(arg, "--drain-timeout") == 0 && val) {
+            config.drain_timeout_ms = std::atoll(val);
+            ++i;
+        } else if (std::strcmp(arg, "--journal") == 0 && val) {
+            config.journal = val;
+            ++i;
+        } else if (std::strcmp(arg, "--replay") == 0 && val) {
+            config.replay = val;
+            ++i;
+        } else if (std::strcmp(arg, "--replay-speed") == 0 && val) {
+            config.replay_speed = std::atof(val);
+            ++i;
+        } else if (std::strcmp(arg, "--order-log") == 0 && val) {
+            config.order_log = val;
+            ++i;
+        } else if (std::strcmp(arg, "--seed") == 0 && val) {
+            seed = std::strtoull(val, nullptr, 10);
+            ++i;
+        } else if (std::strcmp(arg, "--simulate") == 0) {
+            config.simulated = true;
+        } else if (std::strcmp(arg, "--sim-duration") == 0 && val) {
+            config.sim_duration_ms = std::atoll(val);
+            ++i;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    TradeServer server(config);
+    server.setMarketDataGenerator(std::make_unique<MarketDataGenerator>(symbols, seed));
     if (!server.init()) {
         std::cerr << "Failed to init TradeServer" << std::endl;
         return 1;
     }
+    g_server = &server;
+    struct sigaction sa{};
+    sa.sa_handler = onSignal;
+    sa.sa_flags = SA_RESETHAND;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
     server.run();
+    g_server = nullptr;
     return 0;
 }
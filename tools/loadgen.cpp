@@ -0,0 +1,864 @@
+// loadgen: many-connection load generator for TradeServer.
+//
+// Opens N connections over the binary protocol, spread across T threads,
+// each thread running its own epoll loop. Every connection logs in, may
+// narrow its market data subscription, and then the threads issue new and
+// cancel orders (and optionally repeat logins) at fixed aggregate rates.
+//
+// Latency is the round trip from when a request was *due* to when its
+// response arrived, so a stalled server shows up in the percentiles instead
+// of quietly lowering the send rate. Market data is checked per symbol: a
+// delta whose seq skips ahead counts its missing ticks as dropped, a
+// snapshot that jumps ahead counts them as conflated, and a frame whose
+// timestamp is more than --late-ms behind the local clock counts as late.
+//
+//   make loadgen && build/tools/loadgen --connections 2000 --order-rate 20000
+
+#include "BinaryProtocol.h"
+#include "CounterRng.h"
+#include "JsonWriter.h"
+#include "Message.h"
+#include "OrderBook.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::string host = "127.0.0.1";
+    std::uint16_t port = 8000;
+    std::size_t connections = 100;
+    std::size_t threads = 0;            // 0: one per core, at most one per connection
+    double duration_s = 10;
+    double order_rate = 1000;           // new + cancel requests per second, all connections
+    double login_rate = 0;              // extra logins per second on established sessions
+    double cancel_ratio = 0.5;          // share of order slots that cancel a resting order
+    std::vector<std::string> symbols{"A"};  // symbols to trade
+    std::vector<std::string> subscribe; // empty: the server default (every symbol)
+    int price = 100;
+    int price_range = 10;               // limit prices are price +- range
+    std::int64_t late_ms = 100;
+    bool json = false;
+};
+
+using Clock = std::chrono::steady_clock;
+
+std::int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+std::int64_t wallMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+std::vector<std::string> splitList(const char* s) {
+    std::vector<std::string> out;
+    std::string cur;
+    for (; *s; ++s) {
+        if (*s == ',') {
+            if (!cur.empty()) out.push_back(std::move(cur));
+            cur.clear();
+        } else {
+            cur += *s;
+        }
+    }
+    if (!cur.empty()) out.push_back(std::move(cur));
+    return out;
+}
+
+// Log-linear histogram of nanosecond values: exact below 128, then 64
+// sub-buckets per power of two (relative error under 1.6%).
+class LatencyHistogram {
+public:
+    LatencyHistogram() : counts_(kBuckets, 0) {}
+
+    void record(std::int64_t ns) {
+        std::uint64_t v = ns > 0 ? static_cast<std::uint64_t>(ns) : 0;
+        ++counts_[index(v)];
+        ++count_;
+        max_ = std::max(max_, v);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (std::size_t i = 0; i < kBuckets; ++i) counts_[i] += other.counts_[i];
+        count_ += other.count_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    std::uint64_t count() const { return count_; }
+    std::uint64_t max() const { return max_; }
+
+    // Upper bound of the bucket holding the q-quantile.
+    std::uint64_t percentile(double q) const {
+        if (count_ == 0) return 0;
+        const auto target = static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(count_)));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            seen += counts_[i];
+            if (seen >= target && counts_[i]) return std::min(upperBound(i), max_);
+        }
+        return max_;
+    }
+
+private:
+    static constexpr int kSubBits = 6;
+    static constexpr std::size_t kSub = std::size_t{1} << kSubBits;
+    static constexpr std::size_t kBuckets = (64 - kSubBits + 1) * kSub;
+
+    static std::size_t index(std::uint64_t v) {
+        if (v < 2 * kSub) return static_cast<std::size_t>(v);
+        const int shift = std::bit_width(v) - 1 - kSubBits;
+        return static_cast<std::size_t>(shift + 1) * kSub + static_cast<std::size_t>((v >> shift) - kSub);
+    }
+
+    static std::uint64_t upperBound(std::size_t i) {
+        if (i < 2 * kSub) return i;
+        const int shift = static_cast<int>(i / kSub) - 1;
+        return ((i % kSub + kSub + 1) << shift) - 1;
+    }
+
+    std::vector<std::uint64_t> counts_;
+    std::uint64_t count_ = 0;
+    std::uint64_t max_ = 0;
+};
+
+enum Kind : std::size_t { kLogin, kNewOrder, kCancel, kSubscribe, kKinds };
+constexpr const char* kKindNames[kKinds] = {"login", "new_order", "cancel_order", "subscribe"};
+
+struct Stats {
+    LatencyHistogram latency[kKinds];
+    std::uint64_t sent[kKinds] = {};
+    std::uint64_t ok[kKinds] = {};
+    std::uint64_t failed[kKinds] = {};   // answered with a non-200 status
+    std::uint64_t unanswered = 0;        // still outstanding at the end of the run
+    std::uint64_t unmatched = 0;         // responses whose seq was not the oldest outstanding
+    std::uint64_t skipped = 0;           // due while no session was logged in
+    std::uint64_t connected = 0;
+    std::uint64_t connect_failures = 0;
+    std::uint64_t disconnects = 0;
+    std::uint64_t md_frames = 0;
+    std::uint64_t md_updates = 0;        // per-symbol entries in those frames
+    std::uint64_t md_dropped = 0;
+    std::uint64_t md_conflated = 0;
+    std::uint64_t md_late = 0;
+    std::uint64_t exec_reports = 0;
+    std::uint64_t bytes_in = 0;
+
+    void merge(const Stats& o) {
+        for (std::size_t k = 0; k < kKinds; ++k) {
+            latency[k].merge(o.latency[k]);
+            sent[k] += o.sent[k];
+            ok[k] += o.ok[k];
+            failed[k] += o.failed[k];
+        }
+        unanswered += o.unanswered;
+        unmatched += o.unmatched;
+        skipped += o.skipped;
+        connected += o.connected;
+        connect_failures += o.connect_failures;
+        disconnects += o.disconnects;
+        md_frames += o.md_frames;
+        md_updates += o.md_updates;
+        md_dropped += o.md_dropped;
+        md_conflated += o.md_conflated;
+        md_late += o.md_late;
+        exec_reports += o.exec_reports;
+        bytes_in += o.bytes_in;
+    }
+};
+
+// Fixed-rate schedule: request k is due at start + k / rate.
+class Pacer {
+public:
+    Pacer() = default;
+    Pacer(double rate, std::int64_t start) : interval_ns_(rate > 0 ? 1e9 / rate : 0), start_(start) {}
+
+    bool due(std::int64_t now) const { return interval_ns_ > 0 && dueAt() <= now; }
+    std::int64_t dueAt() const { return start_ + static_cast<std::int64_t>(issued_ * interval_ns_); }
+    void advance() { ++issued_; }
+
+private:
+    double interval_ns_ = 0;
+    std::int64_t start_ = 0;
+    std::uint64_t issued_ = 0;
+};
+
+struct Pending {
+    std::uint64_t seq;
+    Kind kind;
+    std::uint32_t symbol;   // index into Options::symbols, for orders
+    std::int64_t due_ns;
+};
+
+struct Resting {
+    std::uint64_t order_id;
+    std::uint32_t symbol;
+};
+
+struct Connection {
+    int fd = -1;
+    bool connecting = true;
+    bool logged_in = false;
+    bool want_write = false;
+    std::string out;
+    std::size_t out_off = 0;
+    std::vector<char> in;
+    std::size_t in_head = 0;
+    std::size_t in_tail = 0;
+    std::uint64_t next_seq = 1;
+    std::deque<Pending> pending;
+    std::vector<Resting> resting;                          // our orders still on the book
+    std::unordered_map<std::uint64_t, std::uint64_t> seqs; // symbol (8 raw bytes) -> last seq
+};
+
+std::uint64_t symbolKey(const char (&name)[8]) {
+    std::uint64_t k;
+    std::memcpy(&k, name, sizeof(k));
+    return k;
+}
+
+
+class Worker {
+public:
+    // `share` is this worker's fraction of the aggregate request rates.
+    Worker(const Options& opts, const sockaddr_in& addr, std::size_t connections, double share,
+           std::uint64_t seed)
+        : opts_(opts), addr_(addr), conns_(connections), rng_(seed), share_(share) {}
+
+    ~Worker() {
+        for (Connection& c : conns_) {
+            if (c.fd >= 0) close(c.fd);
+        }
+        if (epfd_ >= 0) close(epfd_);
+    }
+
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+
+    // Runs until `stop` is set; stats() is complete once this returns.
+    void run(const std::atomic<bool>& stop);
+
+    const Stats& stats() const { return stats_; }
+
+    // Progress counters, safe to read from another thread while running.
+    std::uint64_t connected() const { return connected_.load(std::memory_order_relaxed); }
+    std::uint64_t responses() const { return responses_.load(std::memory_order_relaxed); }
+    std::uint64_t mdFrames() const { return md_frames_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr std::size_t kConnectBatch = 256;   // connects started per loop pass
+    static constexpr std::size_t kMaxResting = 64;      // per connection; beyond it only cancel
+    static constexpr std::size_t kMinReadSpace = 4096;
+    static constexpr std::size_t kInitialReadBuffer = 16 * 1024;
+
+    void startConnects();
+    void onConnected(Connection& c);
+    void handleEvent(std::uint32_t idx, std::uint32_t events);
+    void closeConnection(Connection& c);
+    bool readAll(Connection& c);
+    bool parseFrames(Connection& c);
+    void onResponse(Connection& c, const wire::FrameHeader& h, const char* payload);
+    void onMarketData(Connection& c, const char* payload, std::size_t len, bool delta);
+    void onExecutionReport(Connection& c, const char* payload, std::size_t len);
+    void trackSeq(Connection& c, const char (&symbol)[8], std::uint64_t seq, std::uint64_t& missed);
+    void issueDue(std::int64_t now);
+    Connection* nextReady();
+    void sendLogin(Connection& c, std::int64_t due_ns);
+    void sendOrder(Connection& c, std::int64_t due_ns);
+    void sendFrame(Connection& c, MessageType type, Kind kind, std::uint32_t symbol, std::int64_t due_ns);
+    bool flush(Connection& c);
+    void updateInterest(Connection& c);
+
+    const Options& opts_;
+    sockaddr_in addr_;
+    std::vector<Connection> conns_;
+    CounterRng rng_;
+    double share_;
+    Pacer orders_;
+    Pacer logins_;
+    int epfd_ = -1;
+    std::size_t started_ = 0;     // connections attempted so far
+    std::size_t ready_ = 0;       // logged in and open
+    std::size_t cursor_ = 0;      // round-robin position for requests
+    std::string payload_;         // request payload scratch
+    Stats stats_;
+    std::atomic<std::uint64_t> connected_{0};
+    std::atomic<std::uint64_t> responses_{0};
+    std::atomic<std::uint64_t> md_frames_{0};
+};
+
+void Worker::run(const std::atomic<bool>& stop) {
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd_ < 0) {
+        std::perror("loadgen: epoll_create1");
+        return;
+    }
+    const std::int64_t start = nowNs();
+    orders_ = Pacer(opts_.order_rate * share_, start);
+    logins_ = Pacer(opts_.login_rate * share_, start);
+
+    std::vector<epoll_event> events(1024);
+    while (!stop.load(std::memory_order_relaxed)) {
+        if (started_ < conns_.size()) startConnects();
+        issueDue(nowNs());
+        int n = epoll_wait(epfd_, events.data(), static_cast<int>(events.size()), 1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::perror("loadgen: epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; ++i) handleEvent(events[i].data.u32, events[i].events);
+    }
+    for (const Connection& c : conns_) stats_.unanswered += c.pending.size();
+}
+
+void Worker::startConnects() {
+    const std::size_t end = std::min(started_ + kConnectBatch, conns_.size());
+    for (; started_ < end; ++started_) {
+        Connection& c = conns_[started_];
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            ++stats_.connect_failures;
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (connect(fd, reinterpret_cast<const sockaddr*>(&addr_), sizeof(addr_)) < 0 && errno != EINPROGRESS) {
+            close(fd);
+            ++stats_.connect_failures;
+            continue;
+        }
+        c.fd = fd;
+        c.want_write = true;    // writable = connect finished
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.u32 = static_cast<std::uint32_t>(started_);
+        epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void Worker::onConnected(Connection& c) {
+    c.connecting = false;
+    c.in.resize(kInitialReadBuffer);
+    ++stats_.connected;
+    connected_.fetch_add(1, std::memory_order_relaxed);
+
+    const std::int64_t now = nowNs();
+    sendLogin(c, now);
+    if (c.fd < 0 || opts_.subscribe.empty()) return;
+    payload_.clear();
+    wire::appendPod(payload_, wire::SubscriptionRequest{static_cast<std::uint16_t>(opts_.subscribe.size())});
+    for (const std::string& symbol : opts_.subscribe) {
+        char name[8];
+        wire::copyFixed(name, sizeof(name), symbol);
+        payload_.append(name, sizeof(name));
+    }
+    sendFrame(c, MessageType::Subscribe, kSubscribe, 0, now);
+}
+
+void Worker::handleEvent(std::uint32_t idx, std::uint32_t events) {
+    Connection& c = conns_[idx];
+    if (c.fd < 0) return;
+    if (c.connecting) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0 || (events & (EPOLLERR | EPOLLHUP))) {
+            ++stats_.connect_failures;
+            closeConnection(c);
+            return;
+        }
+        if (!(events & EPOLLOUT)) return;
+        onConnected(c);
+        if (c.fd < 0) return;
+    }
+    if ((events & EPOLLIN) && !readAll(c)) {
+        closeConnection(c);
+        return;
+    }
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        closeConnection(c);
+        return;
+    }
+    if (events & EPOLLOUT) {
+        if (!flush(c)) {
+            closeConnection(c);
+            return;
+        }
+        updateInterest(c);
+    }
+}
+
+void Worker::closeConnection(Connection& c) {
+    if (c.fd < 0) return;
+    close(c.fd);    // also drops it from the epoll set
+    c.fd = -1;
+    if (!c.connecting) ++stats_.disconnects;
+    if (c.logged_in) --ready_;
+    c.logged_in = false;
+    stats_.unanswered += c.pending.size();
+    c.pending.clear();
+}
+
+bool Worker::readAll(Connection& c) {
+    for (;;) {
+        if (c.in.size() - c.in_tail < kMinReadSpace) {
+            if (c.in_head > 0) {
+                std::memmove(c.in.data(), c.in.data() + c.in_head, c.in_tail - c.in_head);
+                c.in_tail -= c.in_head;
+                c.in_head = 0;
+            }
+            if (c.in.size() - c.in_tail < kMinReadSpace) c.in.resize(c.in.size() * 2);
+        }
+        ssize_t r = recv(c.fd, c.in.data() + c.in_tail, c.in.size() - c.in_tail, 0);
+        if (r > 0) {
+            c.in_tail += static_cast<std::size_t>(r);
+            stats_.bytes_in += static_cast<std::uint64_t>(r);
+            if (!parseFrames(c)) return false;
+            continue;
+        }
+        if (r == 0) return false;
+        if (errno == EINTR) continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+bool Worker::parseFrames(Connection& c) {
+    while (c.in_tail - c.in_head >= sizeof(wire::FrameHeader)) {
+        wire::FrameHeader h;
+        std::memcpy(&h, c.in.data() + c.in_head, sizeof(h));
+        if (h.magic != wire::kMagic) {
+            std::fprintf(stderr, "loadgen: bad frame magic 0x%02x, closing connection\n", h.magic);
+            return false;
+        }
+        const std::size_t total = sizeof(h) + h.length;
+        if (c.in_tail - c.in_head < total) break;
+        const char* payload = c.in.data() + c.in_head + sizeof(h);
+        switch (h.type) {
+        case wire::kMarketData: onMarketData(c, payload, h.length, false); break;
+        case wire::kMarketDataDelta: onMarketData(c, payload, h.length, true); break;
+        case wire::kExecutionReport: onExecutionReport(c, payload, h.length); break;
+        default: onResponse(c, h, payload); break;
+        }
+        c.in_head += total;
+    }
+    if (c.in_head == c.in_tail) c.in_head = c.in_tail = 0;
+    return true;
+}
+
+void Worker::onResponse(Connection& c, const wire::FrameHeader& h, const char* payload) {
+    // Responses come back in request order, so the match is the oldest one.
+    if (c.pending.empty() || c.pending.front().seq != h.seq) {
+        ++stats_.unmatched;
+        return;
+    }
+    const Pending p = c.pending.front();
+    c.pending.pop_front();
+    stats_.latency[p.kind].record(nowNs() - p.due_ns);
+    responses_.fetch_add(1, std::memory_order_relaxed);
+
+    std::int32_t status = 0;
+    if (h.length >= sizeof(status)) std::memcpy(&status, payload, sizeof(status));
+    if (status != 200) {
+        ++stats_.failed[p.kind];
+        return;
+    }
+    ++stats_.ok[p.kind];
+    if (p.kind == kLogin && !c.logged_in) {
+        c.logged_in = true;
+        ++ready_;
+    } else if (p.kind == kNewOrder && h.length >= sizeof(wire::OrderResponse)) {
+        wire::OrderResponse resp;
+        std::memcpy(&resp, payload, sizeof(resp));
+        const auto state = static_cast<OrderState>(resp.state);
+        if (resp.leaves_qty > 0 && (state == OrderState::New || state == OrderState::PartiallyFilled)) {
+            c.resting.push_back({resp.order_id, p.symbol});
+        }
+    }
+}
+
+void Worker::trackSeq(Connection& c, const char (&symbol)[8], std::uint64_t seq, std::uint64_t& missed) {
+    auto [it, inserted] = c.seqs.try_emplace(symbolKey(symbol), seq);
+    if (inserted) return;
+    if (seq > it->second + 1) missed += seq - it->second - 1;
+    if (seq > it->second) it->second = seq;
+}
+
+void Worker::onMarketData(Connection& c, const char* payload, std::size_t len, bool delta) {
+    wire::MarketDataHeader mh;
+    if (len < sizeof(mh)) return;
+    std::memcpy(&mh, payload, sizeof(mh));
+    ++stats_.md_frames;
+    md_frames_.fetch_add(1, std::memory_order_relaxed);
+    if (wallMs() - mh.timestamp_ms > opts_.late_ms) ++stats_.md_late;
+
+    std::size_t off = sizeof(mh);
+    for (std::uint16_t i = 0; i < mh.symbol_count; ++i) {
+        if (delta) {
+            wire::DeltaHeader d;
+            if (off + sizeof(d) > len) return;
+            std::memcpy(&d, payload + off, sizeof(d));
+            off += sizeof(d) + d.change_count * sizeof(wire::LevelChange);
+            trackSeq(c, d.symbol, d.seq, stats_.md_dropped);
+        } else {
+            wire::BookHeader b;
+            if (off + sizeof(b) > len) return;
+            std::memcpy(&b, payload + off, sizeof(b));
+            off += sizeof(b) + (b.bid_count + b.ask_count) * sizeof(wire::Level);
+            trackSeq(c, b.symbol, b.seq, stats_.md_conflated);
+        }
+        ++stats_.md_updates;
+    }
+}
+
+void Worker::onExecutionReport(Connection& c, const char* payload, std::size_t len) {
+    wire::ExecutionReport er;
+    if (len < sizeof(er)) return;
+    std::memcpy(&er, payload, sizeof(er));
+    ++stats_.exec_reports;
+    const auto state = static_cast<OrderState>(er.state);
+    if (state != OrderState::Filled && state != OrderState::Cancelled) return;
+    for (std::size_t i = 0; i < c.resting.size(); ++i) {
+        if (c.resting[i].order_id == er.order_id) {
+            c.resting[i] = c.resting.back();
+            c.resting.pop_back();
+            break;
+        }
+    }
+}
+
+void Worker::issueDue(std::int64_t now) {
+    while (orders_.due(now)) {
+        const std::int64_t due = orders_.dueAt();
+        orders_.advance();
+        if (Connection* c = nextReady()) {
+            sendOrder(*c, due);
+        } else {
+            ++stats_.skipped;
+        }
+    }
+    while (logins_.due(now)) {
+        const std::int64_t due = logins_.dueAt();
+        logins_.advance();
+        if (Connection* c = nextReady()) {
+            sendLogin(*c, due);
+        } else {
+            ++stats_.skipped;
+        }
+    }
+}
+
+Connection* Worker::nextReady() {
+    if (ready_ == 0) return nullptr;
+    for (std::size_t tries = 0; tries < conns_.size(); ++tries) {
+        Connection& c = conns_[cursor_];
+        cursor_ = (cursor_ + 1) % conns_.size();
+        if (c.logged_in) return &c;
+    }
+    return nullptr;
+}
+
+void Worker::sendLogin(Connection& c, std::int64_t due_ns) {
+    wire::LoginRequest req{};
+    wire::copyFixed(req.username, sizeof(req.username), "loadgen");
+    wire::copyFixed(req.password, sizeof(req.password), "loadgen");
+    payload_.clear();
+    wire::appendPod(payload_, req);
+    sendFrame(c, MessageType::Login, kLogin, 0, due_ns);
+}
+
+void Worker::sendOrder(Connection& c, std::int64_t due_ns) {
+    payload_.clear();
+    const bool cancel = !c.resting.empty() &&
+                        (c.resting.size() >= kMaxResting || rng_.uniform() < opts_.cancel_ratio);
+    if (cancel) {
+        const Resting r = c.resting.back();
+        c.resting.pop_back();
+        wire::CancelOrderRequest req{};
+        wire::copyFixed(req.symbol, sizeof(req.symbol), opts_.symbols[r.symbol]);
+        req.order_id = r.order_id;
+        wire::appendPod(payload_, req);
+        sendFrame(c, MessageType::CancelOrder, kCancel, r.symbol, due_ns);
+        return;
+    }
+    const auto symbol = static_cast<std::uint32_t>(rng_.uniformInt(0, static_cast<int>(opts_.symbols.size()) - 1));
+    wire::NewOrderRequest req{};
+    wire::copyFixed(req.symbol, sizeof(req.symbol), opts_.symbols[symbol]);
+    req.side = rng_.uniform() < 0.5 ? 0 : 1;
+    req.price = opts_.price + rng_.uniformInt(-opts_.price_range, opts_.price_range);
+    req.quantity = rng_.uniformInt(1, 10);
+    wire::appendPod(payload_, req);
+    sendFrame(c, MessageType::NewOrder, kNewOrder, symbol, due_ns);
+}
+
+void Worker::sendFrame(Connection& c, MessageType type, Kind kind, std::uint32_t symbol, std::int64_t due_ns) {
+    const std::uint64_t seq = c.next_seq++;
+    const std::size_t at = wire::beginFrame(c.out, static_cast<std::uint16_t>(type), seq);
+    c.out += payload_;
+    wire::endFrame(c.out, at);
+    c.pending.push_back({seq, kind, symbol, due_ns});
+    ++stats_.sent[kind];
+    if (!flush(c)) {
+        closeConnection(c);
+        return;
+    }
+    updateInterest(c);
+}
+
+bool Worker::flush(Connection& c) {
+    while (c.out_off < c.out.size()) {
+        ssize_t w = send(c.fd, c.out.data() + c.out_off, c.out.size() - c.out_off, MSG_NOSIGNAL);
+        if (w > 0) {
+            c.out_off += static_cast<std::size_t>(w);
+        } else if (w < 0 && errno == EINTR) {
+            continue;
+        } else if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        } else {
+            return false;
+        }
+    }
+    c.out.clear();
+    c.out_off = 0;
+    return true;
+}
+
+void Worker::updateInterest(Connection& c) {
+    const bool want = c.out_off < c.out.size();
+    if (want == c.want_write) return;
+    epoll_event ev{};
+    ev.events = EPOLLIN | (want ? EPOLLOUT : 0u);
+    ev.data.u32 = static_cast<std::uint32_t>(&c - conns_.data());
+    epoll_ctl(epfd_, EPOLL_CTL_MOD, c.fd, &ev);
+    c.want_write = want;
+}
+
+void usage(const char* prog) {
+    std::fprintf(stderr,
+                 "usage: %s [--host ADDR] [--port N] [--connections N] [--threads N] [--duration S]\n"
+                 "       [--order-rate R] [--login-rate R] [--cancel-ratio F] [--symbols A,B]\n"
+                 "       [--subscribe A,B|*] [--price P] [--price-range N] [--late-ms MS] [--json]\n",
+                 prog);
+}
+
+bool parseOptions(int argc, char** argv, Options& opts) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--json") == 0) {
+            opts.json = true;
+            continue;
+        }
+        const char* val = i + 1 < argc ? argv[++i] : nullptr;
+        if (!val) return false;
+        if (std::strcmp(arg, "--host") == 0) {
+            opts.host = val;
+        } else if (std::strcmp(arg, "--port") == 0) {
+            opts.port = static_cast<std::uint16_t>(std::atoi(val));
+        } else if (std::strcmp(arg, "--connections") == 0) {
+            opts.connections = static_cast<std::size_t>(std::atoll(val));
+        } else if (std::strcmp(arg, "--threads") == 0) {
+            opts.threads = static_cast<std::size_t>(std::atoll(val));
+        } else if (std::strcmp(arg, "--duration") == 0) {
+            opts.duration_s = std::atof(val);
+        } else if (std::strcmp(arg, "--order-rate") == 0) {
+            opts.order_rate = std::atof(val);
+        } else if (std::strcmp(arg, "--login-rate") == 0) {
+            opts.login_rate = std::atof(val);
+        } else if (std::strcmp(arg, "--cancel-ratio") == 0) {
+            opts.cancel_ratio = std::atof(val);
+        } else if (std::strcmp(arg, "--symbols") == 0) {
+            opts.symbols = splitList(val);
+        } else if (std::strcmp(arg, "--subscribe") == 0) {
+            opts.subscribe = splitList(val);
+        } else if (std::strcmp(arg, "--price") == 0) {
+            opts.price = std::atoi(val);
+        } else if (std::strcmp(arg, "--price-range") == 0) {
+            opts.price_range = std::atoi(val);
+        } else if (std::strcmp(arg, "--late-ms") == 0) {
+            opts.late_ms = std::atoll(val);
+        } else {
+            return false;
+        }
+    }
+    return opts.connections > 0 && !opts.symbols.empty() && opts.duration_s > 0;
+}
+
+// Thousands of sockets need more than the usual 1024 descriptors.
+void raiseFdLimit(std::size_t connections) {
+    rlimit rl{};
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) return;
+    const rlim_t want = static_cast<rlim_t>(connections) + 64;
+    if (rl.rlim_cur >= want) return;
+    rl.rlim_cur = std::min(want, rl.rlim_max);
+    setrlimit(RLIMIT_NOFILE, &rl);
+    if (rl.rlim_cur < want) {
+        std::fprintf(stderr, "loadgen: descriptor limit %llu is below %zu connections\n",
+                     static_cast<unsigned long long>(rl.rlim_cur), connections);
+    }
+}
+
+double micros(std::uint64_t ns) {
+    return static_cast<double>(ns) / 1e3;
+}
+
+void printText(const Options& opts, const Stats& s, std::size_t threads, double elapsed_s) {
+    std::printf("loadgen: %zu connections (%llu up, %llu failed, %llu disconnected), %zu threads, %.1f s\n",
+                opts.connections, static_cast<unsigned long long>(s.connected),
+                static_cast<unsigned long long>(s.connect_failures),
+                static_cast<unsigned long long>(s.disconnects), threads, elapsed_s);
+    std::printf("%-14s %10s %10s %8s %10s %10s %10s %10s\n", "request", "sent", "ok", "failed", "p50 us",
+                "p99 us", "p99.9 us", "max us");
+    for (std::size_t k = 0; k < kKinds; ++k) {
+        if (s.sent[k] == 0) continue;
+        const LatencyHistogram& h = s.latency[k];
+        std::printf("%-14s %10llu %10llu %8llu %10.1f %10.1f %10.1f %10.1f\n", kKindNames[k],
+                    static_cast<unsigned long long>(s.sent[k]), static_cast<unsigned long long>(s.ok[k]),
+                    static_cast<unsigned long long>(s.failed[k]), micros(h.percentile(0.50)),
+                    micros(h.percentile(0.99)), micros(h.percentile(0.999)), micros(h.max()));
+    }
+    std::printf("unanswered %llu, unmatched %llu, skipped %llu (due while no session was logged in)\n",
+                static_cast<unsigned long long>(s.unanswered), static_cast<unsigned long long>(s.unmatched),
+                static_cast<unsigned long long>(s.skipped));
+    std::printf("market data: %llu frames (%.0f/s), %llu symbol updates, %llu dropped, %llu conflated, "
+                "%llu late (> %lld ms)\n",
+                static_cast<unsigned long long>(s.md_frames), static_cast<double>(s.md_frames) / elapsed_s,
+                static_cast<unsigned long long>(s.md_updates), static_cast<unsigned long long>(s.md_dropped),
+                static_cast<unsigned long long>(s.md_conflated), static_cast<unsigned long long>(s.md_late),
+                static_cast<long long>(opts.late_ms));
+    std::printf("execution reports: %llu, received %.1f MB\n", static_cast<unsigned long long>(s.exec_reports),
+                static_cast<double>(s.bytes_in) / 1e6);
+}
+
+// One JSON object on stdout; latencies in nanoseconds.
+void printJson(const Options& opts, const Stats& s, std::size_t threads, double elapsed_s) {
+    std::string out;
+    JsonWriter w(out);
+    w.beginObject();
+    w.key("connections").value(opts.connections);
+    w.key("threads").value(threads);
+    w.key("elapsed_ms").value(static_cast<std::int64_t>(elapsed_s * 1e3));
+    w.key("connected").value(s.connected);
+    w.key("connect_failures").value(s.connect_failures);
+    w.key("disconnects").value(s.disconnects);
+    w.key("requests").beginObject();
+    for (std::size_t k = 0; k < kKinds; ++k) {
+        const LatencyHistogram& h = s.latency[k];
+        w.key(kKindNames[k]).beginObject();
+        w.key("sent").value(s.sent[k]);
+        w.key("ok").value(s.ok[k]);
+        w.key("failed").value(s.failed[k]);
+        w.key("p50_ns").value(h.percentile(0.50));
+        w.key("p99_ns").value(h.percentile(0.99));
+        w.key("p999_ns").value(h.percentile(0.999));
+        w.key("max_ns").value(h.max());
+        w.endObject();
+    }
+    w.endObject();
+    w.key("unanswered").value(s.unanswered);
+    w.key("unmatched").value(s.unmatched);
+    w.key("skipped").value(s.skipped);
+    w.key("market_data").beginObject();
+    w.key("frames").value(s.md_frames);
+    w.key("symbol_updates").value(s.md_updates);
+    w.key("dropped").value(s.md_dropped);
+    w.key("conflated").value(s.md_conflated);
+    w.key("late").value(s.md_late);
+    w.key("late_ms").value(opts.late_ms);
+    w.endObject();
+    w.key("execution_reports").value(s.exec_reports);
+    w.key("bytes_in").value(s.bytes_in);
+    w.endObject();
+    out += '\n';
+    std::fwrite(out.data(), 1, out.size(), stdout);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parseOptions(argc, argv, opts)) {
+        usage(argv[0]);
+        return 2;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opts.port);
+    if (inet_pton(AF_INET, opts.host.c_str(), &addr.sin_addr) != 1) {
+        std::fprintf(stderr, "loadgen: --host must be an IPv4 address\n");
+        return 2;
+    }
+    raiseFdLimit(opts.connections);
+
+    std::size_t threads = opts.threads ? opts.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, opts.connections);
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (std::size_t t = 0; t < threads; ++t) {
+        const std::size_t n = opts.connections / threads + (t < opts.connections % threads ? 1 : 0);
+        workers.push_back(std::make_unique<Worker>(opts, addr, n, 1.0 / static_cast<double>(threads),
+                                                   static_cast<std::uint64_t>(nowNs()) + t));
+    }
+
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> running;
+    const auto start = Clock::now();
+    for (auto& w : workers) running.emplace_back([&w, &stop] { w->run(stop); });
+
+    // one progress line per second on stderr
+    const auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opts.duration_s));
+    std::uint64_t last_responses = 0;
+    std::uint64_t last_frames = 0;
+    for (int sec = 1;; ++sec) {
+        const auto next = std::min(end, start + std::chrono::seconds(sec));
+        std::this_thread::sleep_until(next);
+        std::uint64_t connected = 0, responses = 0, frames = 0;
+        for (const auto& w : workers) {
+            connected += w->connected();
+            responses += w->responses();
+            frames += w->mdFrames();
+        }
+        std::fprintf(stderr, "t=%ds connected=%llu responses/s=%llu md frames/s=%llu\n", sec,
+                     static_cast<unsigned long long>(connected),
+                     static_cast<unsigned long long>(responses - last_responses),
+                     static_cast<unsigned long long>(frames - last_frames));
+        last_responses = responses;
+        last_frames = frames;
+        if (next >= end) break;
+    }
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& t : running) t.join();
+    const double elapsed_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+    Stats total;
+    for (const auto& w : workers) total.merge(w->stats());
+    if (opts.json) {
+        printJson(opts, total, threads, elapsed_s);
+    } else {
+        printText(opts, total, threads, elapsed_s);
+    }
+    return 0;
+}